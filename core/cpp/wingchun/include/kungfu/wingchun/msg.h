@@ -11,6 +11,7 @@
 #include <vector>
 #include <nlohmann/json.hpp>
 #include <kungfu/wingchun/common.h>
+#include <kungfu/yijinjing/msg.h>
 #include <kungfu/yijinjing/journal/journal.h>
 
 namespace kungfu
@@ -1386,4 +1387,20 @@ namespace kungfu
     }
 }
 
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Quote, kungfu::wingchun::msg::type::Quote)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Entrust, kungfu::wingchun::msg::type::Entrust)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Transaction, kungfu::wingchun::msg::type::Transaction)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Bar, kungfu::wingchun::msg::type::Bar)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::OrderInput, kungfu::wingchun::msg::type::OrderInput)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::OrderAction, kungfu::wingchun::msg::type::OrderAction)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::OrderActionError, kungfu::wingchun::msg::type::OrderActionError)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Order, kungfu::wingchun::msg::type::Order)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Trade, kungfu::wingchun::msg::type::Trade)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Position, kungfu::wingchun::msg::type::Position)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Asset, kungfu::wingchun::msg::type::Asset)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::PositionDetail, kungfu::wingchun::msg::type::PositionDetail)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::Instrument, kungfu::wingchun::msg::type::Instrument)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::PositionEnd, kungfu::wingchun::msg::type::PositionEnd)
+DECLARE_MSG_TYPE(kungfu::wingchun::msg::data::PositionDetailEnd, kungfu::wingchun::msg::type::PositionDetailEnd)
+
 #endif //WINGCHUN_EVENT_H
@@ -16,11 +16,12 @@ namespace kungfu
 {
     namespace wingchun
     {
-        inline void write_subscribe_msg(const yijinjing::journal::writer_ptr &writer, int64_t trigger_time,
+        inline void write_subscribe_msg(yijinjing::journal::frame_batch &writer, int64_t trigger_time,
                 const std::string &exchange, const std::string &symbol)
         {
-            const size_t buffer_size = 1024;
-            char *buffer = const_cast<char *>(&(writer->open_frame(trigger_time, msg::type::Subscribe, buffer_size)->data<char>()));
+            // fixed fields take less than 128 bytes
+            const size_t buffer_size = 128 + exchange.length() + symbol.length();
+            char *buffer = const_cast<char *>(&(writer.open_frame(trigger_time, msg::type::Subscribe, buffer_size)->data<char>()));
             hffix::message_writer sub_msg(buffer, buffer + buffer_size);
             sub_msg.push_back_header("FIX.4.2");
             sub_msg.push_back_string(hffix::tag::MsgType, "V");
@@ -34,9 +35,16 @@ namespace kungfu
             sub_msg.push_back_string(hffix::tag::SecurityExchange, exchange);
             sub_msg.push_back_string(hffix::tag::Symbol, symbol);
             sub_msg.push_back_trailer();
-            writer->close_frame(sub_msg.message_end() - buffer);
+            writer.close_frame(sub_msg.message_end() - buffer);
             SPDLOG_TRACE("written subscribe msg for {}@{}", symbol, exchange);
         }
+
+        inline void write_subscribe_msg(const yijinjing::journal::writer_ptr &writer, int64_t trigger_time,
+                const std::string &exchange, const std::string &symbol)
+        {
+            yijinjing::journal::frame_batch batch(writer);
+            write_subscribe_msg(batch, trigger_time, exchange, symbol);
+        }
     }
 }
 
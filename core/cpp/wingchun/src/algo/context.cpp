@@ -26,19 +26,16 @@ namespace kungfu
 
             void AlgoContext::react()
             {
-                events_ | is(msg::type::Quote) |
-                $([&](event_ptr event)
+                app_.on<Quote>([&](const Quote &quote)
                 {
                       for(const auto& item: orders_)
                       {
-                          item.second->on_quote(shared_from_this(), event->data<Quote>());
+                          item.second->on_quote(shared_from_this(), quote);
                       }
                 });
 
-                events_ | is(msg::type::Order) |
-                $([&](event_ptr event)
+                app_.on<Order>([&](const Order &order)
                 {
-                    const auto& order = event->data<Order>();
                     auto order_id = order.parent_id;
                     if (has_order(order_id))
                     {
@@ -46,10 +43,8 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(msg::type::Trade) |
-                $([&](event_ptr event)
+                app_.on<Trade>([&](const Trade &trade)
                 {
-                    const auto& trade = event->data<Trade>();
                     auto order_id = trade.parent_order_id;
                     if (has_order(order_id))
                     {
@@ -57,8 +52,7 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(msg::type::AlgoOrderReport) |
-                $([&](event_ptr event)
+                app_.on(msg::type::AlgoOrderReport, [&](const event_ptr &event)
                 {
                     try
                     {
@@ -181,8 +181,7 @@ namespace kungfu
                     }
                 }
 
-                events_ | is(yijinjing::msg::type::Channel) |
-                $([=](event_ptr event)
+                app_.on(yijinjing::msg::type::Channel, [=](const event_ptr &event)
                 {
                     const auto& channel = event->data<yijinjing::msg::data::Channel>();
                     if (channel.source_id == location->uid)
@@ -217,12 +216,11 @@ namespace kungfu
                 events_ | filter([=](event_ptr event) { return event->msg_type() == msg::type::PositionDetailEnd and event->data<PositionDetailEnd>().holder_uid == location->uid;}) |
                 first() | $([=](event_ptr event) { book->ready_ = true; });
 
-                events_ | is(msg::type::Quote) |
-                $([=](event_ptr event)
+                app_.on<Quote>([=](const event_ptr &event, const Quote &quote)
                 {
                     try
                     {
-                        book->on_quote(event, event->data<msg::data::Quote>());
+                        book->on_quote(event, quote);
                     }
                     catch (const std::exception &e)
                     {
@@ -230,15 +228,15 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(msg::type::Trade) | filter([=](yijinjing::event_ptr e)
-                {
-                    return location->category == category::TD ? location->uid == e->source() : location->uid == e->dest();
-                }) |
-                $([=](event_ptr event)
+                app_.on<Trade>([=](const event_ptr &event, const Trade &trade)
                 {
+                    if (location->uid != (location->category == category::TD ? event->source() : event->dest()))
+                    {
+                        return;
+                    }
                     try
                     {
-                        book->on_trade(event, event->data<Trade>());
+                        book->on_trade(event, trade);
                     }
                     catch (const std::exception &e)
                     {
@@ -246,16 +244,15 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(msg::type::Order) | filter([=](yijinjing::event_ptr e)
-                {
-                    return location->category == category::TD ? location->uid == e->source() : location->uid == e->dest();
-                }) |
-                $([=](event_ptr event)
+                app_.on<Order>([=](const event_ptr &event, const Order &order)
                   {
+                      if (location->uid != (location->category == category::TD ? event->source() : event->dest()))
+                      {
+                          return;
+                      }
                       try
                       {
-                          const auto& data = event->data<Order>();
-                          book->on_order(event, event->data<Order>());
+                          book->on_order(event, order);
                       }
                       catch (const std::exception &e)
                       {
@@ -263,16 +260,15 @@ namespace kungfu
                       }
                   });
 
-                events_ | is(msg::type::OrderInput) | filter([=](yijinjing::event_ptr e)
-                {
-                    return location->category == category::TD ? location->uid == e->dest() : location->uid == e->source();
-                }) |
-                $([=](event_ptr event)
+                app_.on<OrderInput>([=](const event_ptr &event, const OrderInput &input)
                   {
+                      if (location->uid != (location->category == category::TD ? event->dest() : event->source()))
+                      {
+                          return;
+                      }
                       try
                       {
-                          const auto& data = event->data<OrderInput>();
-                          book->on_order_input(event, event->data<OrderInput>());
+                          book->on_order_input(event, input);
                       }
                       catch (const std::exception &e)
                       {
@@ -280,15 +276,15 @@ namespace kungfu
                       }
                   });
 
-                events_ | is(msg::type::Asset) | filter([=](yijinjing::event_ptr e)
-                {
-                    const auto& asset = e->data<Asset>();
-                    return asset.holder_uid == location->uid;
-                })  | $([=](event_ptr event)
+                app_.on<Asset>([=](const event_ptr &event, const Asset &asset)
                 {
+                    if (asset.holder_uid != location->uid)
+                    {
+                        return;
+                    }
                     try
                     {
-                        book->on_asset(event, event->data<Asset>());
+                        book->on_asset(event, asset);
                     }
                     catch (const std::exception &e)
                     {
@@ -296,8 +292,7 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(yijinjing::msg::type::TradingDay) |
-                $([=](event_ptr event)
+                app_.on(yijinjing::msg::type::TradingDay, [=](const event_ptr &event)
                 {
                     try {
                         book->on_trading_day(event, event->data<int64_t>());
@@ -31,14 +31,12 @@ namespace kungfu
             {
                 apprentice::on_start();
 
-                events_ | is(msg::type::OrderInput) |
-                $([&](event_ptr event)
+                on(msg::type::OrderInput, [&](const event_ptr &event)
                   {
                       insert_order(event);
                   });
 
-                events_ | is(msg::type::OrderAction) |
-                $([&](event_ptr event)
+                on(msg::type::OrderAction, [&](const event_ptr &event)
                   {
                       cancel_order(event);
                   });
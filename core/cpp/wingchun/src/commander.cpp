@@ -94,8 +94,7 @@ namespace kungfu
         {
             apprentice::on_start();
 
-            events_ | is(msg::type::Order) |
-            $([&](event_ptr event)
+            on(msg::type::Order, [&](const event_ptr &event)
               {
                   try
                   { on_order(event, event->data<Order>()); }
@@ -34,20 +34,17 @@ namespace kungfu
                     context_ = std::make_shared<algo::AlgoContext>(*this, events_);
                     context_->react();
 
-                    events_ | is(msg::type::AlgoOrderInput) |
-                    $([&](event_ptr event)
+                    on(msg::type::AlgoOrderInput, [&](const event_ptr &event)
                     {
                         insert_order(event, event->data_as_string());
                     });
 
-                    events_ | is(msg::type::OrderAction) |
-                    $([&](event_ptr event)
+                    on(msg::type::OrderAction, [&](const event_ptr &event)
                     {
                         cancel_order(event, event->data<msg::data::OrderAction>());
                     });
 
-                    events_ | is(msg::type::AlgoOrderModify) |
-                    $([&](event_ptr event)
+                    on(msg::type::AlgoOrderModify, [&](const event_ptr &event)
                     {
                         modify_order(event, event->data_as_string());
                     });
@@ -133,10 +133,8 @@ namespace kungfu
             {
                 apprentice::on_start();
 
-                events_ | is(msg::type::Quote) |
-                $([&](event_ptr event)
+                on<Quote>([&](const Quote &quote)
                 {
-                    const auto& quote = event->data<Quote>();
                     auto symbol_id = get_symbol_id(quote.get_instrument_id(), quote.get_exchange_id());
                     if (bars_.find(symbol_id) != bars_.end())
                     {
@@ -193,8 +191,7 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(msg::type::Subscribe) |
-                $([&](event_ptr event)
+                on(msg::type::Subscribe, [&](const event_ptr &event)
                 {
                     SPDLOG_INFO("subscribe request");
                     std::vector<Instrument> symbols;
@@ -203,19 +203,19 @@ namespace kungfu
 
                 pre_start();
 
-                events_ | is(msg::type::BrokerState) |
-                $([&](event_ptr event)
+                on(msg::type::BrokerState, [&](const event_ptr &event)
                   {
                       auto broker_location = get_location(event->source());
                       update_broker_state(event->gen_time(), broker_location, static_cast<BrokerState>(event->data<int32_t>()));
                   });
 
-                events_ | is(msg::type::Position) | filter([&](event_ptr event) {
-                    auto source = event->source();
-                    return this->has_location(source) && this->get_location(source)->category == category::TD;
-                }) |
-                $([&](event_ptr event)
+                on(msg::type::Position, [&](const event_ptr &event)
                 {
+                    auto source = event->source();
+                    if (not has_location(source) or get_location(source)->category != category::TD)
+                    {
+                        return;
+                    }
                     const auto& position = event->data<msg::data::Position>();
                     auto insts = convert_to_instruments(std::vector<msg::data::Position>({position}));
                     request_subscribe(event->source(), insts);
@@ -224,41 +224,37 @@ namespace kungfu
                 /**
                  * process trade events
                  */
-                events_ | is(msg::type::Quote) |
-                $([&](event_ptr event)
+                on<Quote>([&](const event_ptr &event, const Quote &quote)
                   {
                       try
-                      { on_quote(event, event->data<Quote>()); }
+                      { on_quote(event, quote); }
                       catch (const std::exception &e)
                       {
                           SPDLOG_ERROR("Unexpected exception {}", e.what());
                       }
                   });
 
-                events_ | is(msg::type::Order) |
-                $([&](event_ptr event)
+                on<Order>([&](const event_ptr &event, const Order &order)
                   {
                       try
-                      { on_order(event, event->data<Order>()); }
+                      { on_order(event, order); }
                       catch (const std::exception &e)
                       {
                           SPDLOG_ERROR("Unexpected exception {}", e.what());
                       }
                   });
 
-                events_ | is(msg::type::Trade) |
-                $([&](event_ptr event)
+                on<Trade>([&](const event_ptr &event, const Trade &trade)
                   {
                       try
-                      { on_trade(event, event->data<Trade>()); }
+                      { on_trade(event, trade); }
                       catch (const std::exception &e)
                       {
                           SPDLOG_ERROR("Unexpected exception {}", e.what());
                       }
                   });
 
-                events_ | is(msg::type::QryAsset) |
-                $([&](event_ptr event)
+                on(msg::type::QryAsset, [&](const event_ptr &event)
                 {
                     try
                     {
@@ -281,8 +277,7 @@ namespace kungfu
                     }
                 });
 
-                events_ | is(msg::type::InstrumentRequest) |
-                $([&](event_ptr event)
+                on(msg::type::InstrumentRequest, [&](const event_ptr &event)
                 {
                     try {
                         handle_instrument_request(event);
@@ -437,9 +432,10 @@ namespace kungfu
 
                 auto write_sub_msg = [=]()
                 {
+                    yijinjing::journal::frame_batch batch(this->get_writer(md_location->uid));
                     for (const auto &instrument : instruments)
                     {
-                        write_subscribe_msg(this->get_writer(md_location->uid), now(), instrument.exchange_id, instrument.instrument_id);
+                        write_subscribe_msg(batch, now(), instrument.exchange_id, instrument.instrument_id);
                     }
                 };
 
@@ -36,34 +36,28 @@ namespace kungfu
             {
                 algo_context_->react();
 
-                events_ | is(msg::type::Quote) |
-                $([&](event_ptr event)
+                app_.on<Quote>([&](const Quote &quote)
                   {
-                      const Quote &quote = event->data<Quote>();
                       auto id = get_symbol_id(quote.get_instrument_id(), quote.get_exchange_id());
                       quotes_[id].last_price = quote.last_price;
                   });
 
-                events_ | is(msg::type::Order) | to(app_.get_home_uid()) |
-                $([&](event_ptr event)
+                app_.on_to(msg::type::Order, app_.get_home_uid(), [&](const event_ptr &event)
                   {
                       auto order = event->data<Order>();
                   });
 
-                events_ | is(msg::type::Trade) | to(app_.get_home_uid()) |
-                $([&](event_ptr event)
+                app_.on_to(msg::type::Trade, app_.get_home_uid(), [&](const event_ptr &event)
                   {
                       auto trade = event->data<Trade>();
                   });
 
-                events_ | is(msg::type::Entrust) |
-                $([&](event_ptr event)
+                app_.on(msg::type::Entrust, [&](const event_ptr &event)
                   {
                       auto entrust = event->data<Entrust>();
                   });
 
-                events_ | is(msg::type::Transaction) |
-                $([&](event_ptr event)
+                app_.on(msg::type::Transaction, [&](const event_ptr &event)
                   {
                       auto transaction = event->data<Transaction>();
                   });
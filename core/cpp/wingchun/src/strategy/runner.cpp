@@ -55,66 +55,75 @@ namespace kungfu
                     strategy->pre_start(context_);
                 }
 
-                events_ | is(msg::type::Quote) | filter([=](event_ptr event) { return context_->is_subscribed(event->data<Quote>());}) |
-                $([&](event_ptr event)
+                on<Quote>([&](const Quote &quote)
                 {
+                    if (not context_->is_subscribed(quote))
+                    {
+                        return;
+                    }
                     for (const auto &strategy : strategies_)
                     {
-                        strategy->on_quote(context_, event->data<Quote>());
+                        strategy->on_quote(context_, quote);
                     }
                 });
 
-                events_ | is(msg::type::Bar) | filter([=](event_ptr event) { return context_->is_subscribed(event->data<Bar>());}) |
-                $([&](event_ptr event)
+                on<Bar>([&](const Bar &bar)
                   {
+                      if (not context_->is_subscribed(bar))
+                      {
+                          return;
+                      }
                       for (const auto &strategy : strategies_)
                       {
-                          strategy->on_bar(context_, event->data<Bar>());
+                          strategy->on_bar(context_, bar);
                       }
                   });
 
-                events_ | is(msg::type::Order) | to(context_->app_.get_home_uid()) |
-                $([&](event_ptr event)
+                on_to<Order>(context_->app_.get_home_uid(), [&](const Order &order)
                   {
                       for (const auto &strategy : strategies_)
                       {
-                          strategy->on_order(context_, event->data<Order>());
+                          strategy->on_order(context_, order);
                       }
                   });
 
-                events_ | is(msg::type::OrderActionError) | to(context_->app_.get_home_uid()) |
-                $([&](event_ptr event)
+                on_to<OrderActionError>(context_->app_.get_home_uid(), [&](const OrderActionError &error)
                   {
                       for (const auto &strategy : strategies_)
                       {
-                          strategy->on_order_action_error(context_, event->data<OrderActionError>());
+                          strategy->on_order_action_error(context_, error);
                       }
                   });
 
-                events_ | is(msg::type::Trade) | to(context_->app_.get_home_uid()) |
-                $([&](event_ptr event)
+                on_to<Trade>(context_->app_.get_home_uid(), [&](const Trade &trade)
                   {
                       for (const auto &strategy : strategies_)
                       {
-                          strategy->on_trade(context_, event->data<Trade>());
+                          strategy->on_trade(context_, trade);
                       }
                   });
 
-                events_ | is(msg::type::Entrust) | filter([=](event_ptr event) { return context_->is_subscribed(event->data<Entrust>());}) |
-                $([&](event_ptr event)
+                on<Entrust>([&](const Entrust &entrust)
                   {
+                      if (not context_->is_subscribed(entrust))
+                      {
+                          return;
+                      }
                       for (const auto &strategy : strategies_)
                       {
-                          strategy->on_entrust(context_, event->data<Entrust>());
+                          strategy->on_entrust(context_, entrust);
                       }
                   });
 
-                events_ | is(msg::type::Transaction) | filter([=](event_ptr event) { return context_->is_subscribed(event->data<Transaction>());}) |
-                $([&](event_ptr event)
+                on<Transaction>([&](const Transaction &transaction)
                   {
+                      if (not context_->is_subscribed(transaction))
+                      {
+                          return;
+                      }
                       for (const auto &strategy : strategies_)
                       {
-                          strategy->on_transaction(context_, event->data<Transaction>());
+                          strategy->on_transaction(context_, transaction);
                       }
                   });
 
@@ -5,6 +5,9 @@
 #ifndef KUNGFU_HERO_H
 #define KUNGFU_HERO_H
 
+#include <deque>
+#include <functional>
+#include <type_traits>
 #include <unordered_map>
 
 #include <kungfu/yijinjing/io.h>
@@ -15,6 +18,10 @@ namespace kungfu
 {
     namespace practice
     {
+        using event_handler = std::function<void(const yijinjing::event_ptr &)>;
+
+        using frame_handler = std::function<void(const yijinjing::event_ptr &, const yijinjing::journal::frame &)>;
+
         class hero
         {
         public:
@@ -61,6 +68,48 @@ namespace kungfu
             yijinjing::journal::reader_ptr get_reader() const
             { return reader_; }
 
+            /**
+             * declare msg types wanted from journals joined on request, frames of other types are skipped inside
+             * reader, yijinjing system msgs always pass, no declaration means all
+             */
+            void declare_interest(int32_t msg_type)
+            { interests_.accept(msg_type); }
+
+            const yijinjing::journal::frame_filter &get_interests() const
+            { return interests_; }
+
+            /**
+             * handle events of msg_type, dispatched through a table indexed by msg type before events reach rx
+             * subscribers, so that other events never pass through the handler as with events_ | is(msg_type) | $(...),
+             * handlers of the same msg type are called in order of registration.
+             * Events of journal frames are non-owning views of the reader frame, only valid until the reader moves on,
+             * copy out the data instead of keeping the event_ptr
+             */
+            void on(int32_t msg_type, const event_handler &handler);
+
+            /** handle events of msg_type from source only */
+            void on_from(int32_t msg_type, uint32_t source, const event_handler &handler);
+
+            /** handle events of msg_type to dest only */
+            void on_to(int32_t msg_type, uint32_t dest, const event_handler &handler);
+
+            /**
+             * handle journal frames carrying T, msg type comes from msg_traits<T>, handler takes (const T &) or
+             * (const event_ptr &, const T &) and is called with the frame data directly, nanomsg events of the same
+             * msg type carry json instead of T and are not passed to typed handlers
+             */
+            template<typename T, typename Handler>
+            void on(Handler handler)
+            { add_handler(yijinjing::msg::msg_traits<T>::type, {false, false, 0, 0, nullptr, typed<T>(std::move(handler))}); }
+
+            template<typename T, typename Handler>
+            void on_from(uint32_t source, Handler handler)
+            { add_handler(yijinjing::msg::msg_traits<T>::type, {true, false, source, 0, nullptr, typed<T>(std::move(handler))}); }
+
+            template<typename T, typename Handler>
+            void on_to(uint32_t dest, Handler handler)
+            { add_handler(yijinjing::msg::msg_traits<T>::type, {false, true, 0, dest, nullptr, typed<T>(std::move(handler))}); }
+
             bool has_location(uint32_t hash);
 
             yijinjing::data::location_ptr get_location(uint32_t hash);
@@ -80,6 +129,7 @@ namespace kungfu
             std::unordered_map<uint32_t, yijinjing::data::location_ptr> locations_;
 
             yijinjing::journal::reader_ptr reader_;
+            yijinjing::journal::frame_filter interests_;
             std::unordered_map<uint32_t, yijinjing::journal::writer_ptr> writers_;
             int64_t begin_time_;
             int64_t end_time_;
@@ -107,8 +157,43 @@ namespace kungfu
             virtual void react() = 0;
 
         private:
+            struct dispatch_entry
+            {
+                bool match_source;
+                bool match_dest;
+                uint32_t source;
+                uint32_t dest;
+                event_handler handler;
+                frame_handler typed_handler;
+            };
+
             yijinjing::io_device_with_reply_ptr io_device_;
             volatile bool live_ = true;
+            yijinjing::nanomsg::nanomsg_json_pool json_pool_;
+            /** deque keeps entries in place when handlers register more handlers during dispatch */
+            std::unordered_map<int32_t, std::deque<dispatch_entry>> dispatch_table_;
+
+            void add_handler(int32_t msg_type, const dispatch_entry &entry);
+
+            /** @param frame the journal frame behind event, nullptr for nanomsg events */
+            void dispatch(const rx::subscriber<yijinjing::event_ptr> &sb, const yijinjing::event_ptr &event,
+                          const yijinjing::journal::frame *frame);
+
+            /** frame::data<T>() reads the body without a virtual call */
+            template<typename T, typename Handler>
+            static frame_handler typed(Handler handler)
+            {
+                return [handler](const yijinjing::event_ptr &event, const yijinjing::journal::frame &frame)
+                {
+                    if constexpr (std::is_invocable_v<Handler, const yijinjing::event_ptr &, const T &>)
+                    {
+                        handler(event, frame.data<T>());
+                    } else
+                    {
+                        handler(frame.data<T>());
+                    }
+                };
+            }
 
             static void delegate_produce(hero *instance, const rx::subscriber<yijinjing::event_ptr> &sb);
         };
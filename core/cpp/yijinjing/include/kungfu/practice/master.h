@@ -6,6 +6,7 @@
 #define KUNGFU_MASTER_H
 
 #include <unordered_map>
+#include <vector>
 
 #include <kungfu/yijinjing/io.h>
 #include <kungfu/yijinjing/msg.h>
@@ -21,6 +22,30 @@ namespace kungfu
             int64_t duration;
             int64_t repeat_limit;
             int64_t repeat_count;
+            uint64_t generation;
+        };
+
+        /** checkpoint of a timer task, queued in master's min-heap, stale once its task is re-requested or removed */
+        struct TimerCheckpoint
+        {
+            int64_t checkpoint;
+            uint32_t app_id;
+            int32_t task_id;
+            uint64_t generation;
+
+            bool operator>(const TimerCheckpoint &other) const
+            { return checkpoint > other.checkpoint; }
+        };
+
+        /** how late timer tasks fire compared to their checkpoints */
+        struct TimerStats
+        {
+            int64_t fire_count = 0;
+            int64_t lateness_total = 0;
+            int64_t lateness_max = 0;
+
+            int64_t get_lateness_mean() const
+            { return fire_count > 0 ? lateness_total / fire_count : 0; }
         };
 
         class master : public hero
@@ -46,6 +71,9 @@ namespace kungfu
 
             void send_time(uint32_t dest, int32_t msg_type, int64_t nanotime);
 
+            const TimerStats &get_timer_stats() const
+            { return timer_stats_; }
+
         protected:
 
             bool produce_one(const rx::subscriber<yijinjing::event_ptr> &sb) override ;
@@ -58,6 +86,15 @@ namespace kungfu
             int64_t last_check_;
             std::unordered_map<uint32_t, uint32_t> app_locations_;
             std::unordered_map<uint32_t, std::unordered_map<int32_t, TimerTask>> timer_tasks_;
+            /** min-heap on checkpoint, the loop only looks at its top until a task is due */
+            std::vector<TimerCheckpoint> timer_queue_;
+            std::vector<TimerCheckpoint> timer_due_;
+            uint64_t timer_generation_;
+            TimerStats timer_stats_;
+
+            void schedule_timer(uint32_t app_id, int32_t task_id, const TimerTask &task);
+
+            void fire_timers(int64_t now);
         };
     }
 }
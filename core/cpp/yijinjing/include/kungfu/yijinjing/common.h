@@ -90,11 +90,50 @@ namespace kungfu
 
             virtual int notify() = 0;
 
+            /** notify observers of frames committed to journals of given location */
+            virtual int notify_location(uint32_t location_uid)
+            { return notify(); }
+
             virtual int publish(const std::string &json_message) = 0;
         };
 
         DECLARE_PTR(publisher)
 
+        /**
+         * How an idle observer waits for notices: busy spin for spin_us, then yield cpu until yield_us has elapsed,
+         * then block in slices of block_ms. Negative spin_us leaves spinning to the caller loop, wait returns at once.
+         */
+        struct wait_strategy
+        {
+            int64_t spin_us = 0;
+            int64_t yield_us = 0;
+            int block_ms = 10;
+        };
+
+        /** per process wait counters, times in nanoseconds */
+        struct wait_stats
+        {
+            uint64_t idle_count = 0;
+            uint64_t spin_wakeup_count = 0;
+            uint64_t yield_wakeup_count = 0;
+            uint64_t block_wakeup_count = 0;
+            uint64_t timeout_count = 0;
+            int64_t spin_time = 0;
+            int64_t block_time = 0;
+            int64_t wakeup_latency_total = 0;
+            int64_t wakeup_latency_max = 0;
+
+            uint64_t get_wakeup_count() const
+            { return spin_wakeup_count + yield_wakeup_count + block_wakeup_count; }
+
+            /** mean time from notice to wakeup of the waiting observer */
+            double get_wakeup_latency_mean() const
+            {
+                uint64_t count = get_wakeup_count();
+                return count > 0 ? double(wakeup_latency_total) / count : 0;
+            }
+        };
+
         class observer
         {
         public:
@@ -104,6 +143,19 @@ namespace kungfu
             virtual bool wait() = 0;
 
             virtual const std::string &get_notice() = 0;
+
+            void set_wait_strategy(const wait_strategy &strategy)
+            { strategy_ = strategy; }
+
+            const wait_strategy &get_wait_strategy() const
+            { return strategy_; }
+
+            const wait_stats &get_wait_stats() const
+            { return stats_; }
+
+        protected:
+            wait_strategy strategy_;
+            wait_stats stats_;
         };
 
         DECLARE_PTR(observer)
@@ -221,6 +273,12 @@ namespace kungfu
                 virtual const std::string default_to_system_db(location_ptr location, const std::string &name) const = 0;
 
                 virtual const std::vector<int> list_page_id(location_ptr location, uint32_t dest_id) const = 0;
+
+                /**
+                 * size of new journal pages for given location and dest, existing pages always keep the size in their header
+                 * @return page size in bytes, defaults to journal::find_page_size
+                 */
+                virtual uint32_t page_size(location_ptr location, uint32_t dest_id) const;
             };
 
             class location : public std::enable_shared_from_this<location>
@@ -44,8 +44,12 @@ namespace kungfu
             bool is_low_latency()
             { return low_latency_; }
 
+            /** reader of the hero loop, observer looks into it before going idle */
             journal::reader_ptr open_reader_to_subscribe();
 
+            const journal::reader_ptr &get_subscribe_reader() const
+            { return subscribe_reader_; }
+
             journal::reader_ptr open_reader(const data::location_ptr &location, uint32_t dest_id);
 
             journal::writer_ptr open_writer(uint32_t dest_id);
@@ -67,6 +71,13 @@ namespace kungfu
             observer_ptr get_observer()
             { return observer_; }
 
+            /** how hero loops wait for notices when idle, low latency devices leave spinning to the loop by default */
+            void set_wait_strategy(const wait_strategy &strategy)
+            { observer_->set_wait_strategy(strategy); }
+
+            const wait_stats &get_wait_stats() const
+            { return observer_->get_wait_stats(); }
+
         protected:
             data::location_ptr home_;
             data::location_ptr live_home_;
@@ -75,6 +86,7 @@ namespace kungfu
             nanomsg::url_factory_ptr url_factory_;
             publisher_ptr publisher_;
             observer_ptr observer_;
+            journal::reader_ptr subscribe_reader_;
         };
 
         DECLARE_PTR(io_device)
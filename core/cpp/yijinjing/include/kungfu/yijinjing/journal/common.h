@@ -7,7 +7,9 @@
 
 #include <kungfu/yijinjing/common.h>
 
-#define __JOURNAL_VERSION__ 4
+#define __JOURNAL_VERSION__ 5
+/** oldest journal version still readable, v4 frames are neither padded nor aligned */
+#define __JOURNAL_VERSION_MIN__ 4
 
 namespace kungfu
 {
@@ -45,6 +45,8 @@ namespace kungfu
                 uint32_t source;
                 /** dest of this frame */
                 uint32_t dest;
+                /** length of data body, frame length is padded up to FRAME_ALIGNMENT (v5, absent in v4 frames) */
+                uint32_t data_length;
 #ifndef _WIN32
             } __attribute__((packed));
 #else
@@ -52,30 +54,62 @@ namespace kungfu
 #pragma pack(pop)
 #endif
 
+            /** header length of v4 frames, which end right before data_length */
+            constexpr uint32_t FRAME_HEADER_LENGTH_V4 = 36;
+
+            /** frames start at multiples of this within a page (v5), so that data body is 8 bytes aligned */
+            constexpr uint32_t FRAME_ALIGNMENT = 8;
+
+            /** frame length padded up to FRAME_ALIGNMENT */
+            inline constexpr uint32_t align_frame_length(uint32_t length)
+            { return (length + FRAME_ALIGNMENT - 1) & ~(FRAME_ALIGNMENT - 1); }
+
+            /** store that becomes visible only after all stores before it, pairs with load_acquire in other threads or processes */
+            template<typename T>
+            inline void store_release(volatile T *address, T value)
+            {
+#ifdef _WIN32
+                *address = value; // msvc volatile stores have release semantics
+#else
+                __atomic_store_n(address, value, __ATOMIC_RELEASE);
+#endif
+            }
+
+            template<typename T>
+            inline T load_acquire(const volatile T *address)
+            {
+#ifdef _WIN32
+                return *address; // msvc volatile loads have acquire semantics
+#else
+                return __atomic_load_n(address, __ATOMIC_ACQUIRE);
+#endif
+            }
+
             /**
              * Basic memory unit,
              * holds header / data / errorMsg (if needs)
              */
-            class frame : public event
+            class frame final : public event
             {
             public:
 
                 ~frame() override = default;
 
                 [[nodiscard]] bool has_data() const
-                { return header_->length > 0 && header_->msg_type > 0; }
+                { return frame_length() > 0 && header_->msg_type > 0; }
 
                 [[nodiscard]] uintptr_t address() const
                 { return reinterpret_cast<uintptr_t>(header_); }
 
+                /** acquires the rest of the frame published by set_data_length */
                 [[nodiscard]] uint32_t frame_length() const
-                { return header_->length; }
+                { return load_acquire(length_address()); }
 
                 [[nodiscard]] uint32_t header_length() const
                 { return header_->header_length; }
 
                 [[nodiscard]] uint32_t data_length() const override
-                { return frame_length() - header_length(); }
+                { return header_length() > FRAME_HEADER_LENGTH_V4 ? header_->data_length : frame_length() - header_length(); }
 
                 [[nodiscard]] int64_t gen_time() const override
                 { return header_->gen_time; }
@@ -101,6 +135,11 @@ namespace kungfu
                 [[nodiscard]] const std::string to_string() const override
                 { return std::string(reinterpret_cast<char *>(address())); }
 
+                /** hides event::data, reads the body without going through the virtual data_address() */
+                template<typename T>
+                const T &data() const
+                { return *(reinterpret_cast<const T *>(address() + header_length())); }
+
                 template<typename T>
                 size_t copy_data(const T& data)
                 {
@@ -121,6 +160,10 @@ namespace kungfu
 
                 frame() = default;
 
+                /** length is the first field of header, reached through frame address to stay clear of packed member warnings */
+                [[nodiscard]] volatile uint32_t *length_address() const
+                { return reinterpret_cast<volatile uint32_t *>(address()); }
+
                 void set_address(uintptr_t address)
                 { header_ = reinterpret_cast<frame_header *>(address); }
 
@@ -130,8 +173,12 @@ namespace kungfu
                 void set_header_length()
                 { header_->header_length = sizeof(frame_header); }
 
+                /** sets frame length last with release semantics, which publishes the frame along with all header stores before */
                 void set_data_length(uint32_t length)
-                { header_->length = header_length() + length; }
+                {
+                    header_->data_length = length;
+                    store_release(length_address(), align_frame_length(header_length() + length));
+                }
 
                 void set_gen_time(int64_t gen_time)
                 { header_->gen_time = gen_time; }
@@ -18,6 +18,11 @@
 
 #include <utility>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <streambuf>
+#include <bitset>
 
 #include <kungfu/yijinjing/msg.h>
 #include <kungfu/yijinjing/journal/common.h>
@@ -35,7 +40,104 @@ namespace kungfu
 
             FORWARD_DECLARE_PTR(page_provider)
 
-            FORWARD_DECLARE_PTR(page_provider_factory)
+            /**
+             * Page provider for journal writers, prepares (opens, stretches, maps and pre-faults) the next page
+             * on a helper thread while current page is being written, so that page rollover is a pointer swap
+             */
+            class page_provider : public std::enable_shared_from_this<page_provider>
+            {
+            public:
+                page_provider(data::location_ptr location, uint32_t dest_id, bool lazy) :
+                        location_(std::move(location)), dest_id_(dest_id), lazy_(lazy), preparing_id_(0)
+                {}
+
+                /**
+                 * get page for writing, takes the prepared one if available, otherwise loads it in place
+                 * @param page_id
+                 * @return page
+                 */
+                page_ptr get_page(int page_id);
+
+                /**
+                 * schedule preparation of page on helper thread
+                 * @param page_id
+                 */
+                void prepare(int page_id);
+
+            private:
+                const data::location_ptr location_;
+                const uint32_t dest_id_;
+                const bool lazy_;
+                std::mutex mutex_;
+                std::condition_variable prepared_cv_;
+                int preparing_id_;
+                page_ptr prepared_;
+
+                void do_prepare(int page_id, const std::string &path, const std::string &frame_index_path, bool huge_page,
+                                uint32_t page_size);
+            };
+
+            /** msg types below this are filtered by bitmask, yijinjing system msg types above it always pass */
+            constexpr int32_t FRAME_FILTER_MSG_TYPE_LIMIT = 1024;
+
+            /**
+             * Frame filter pushed down into reader, frames it rejects are skipped before they become events.
+             * A default constructed filter accepts all frames.
+             */
+            class frame_filter
+            {
+            public:
+                frame_filter() : all_msg_types_(true), match_source_(false), match_dest_(false), source_(0), dest_(0)
+                {}
+
+                /** accept given msg type, the first call stops accepting all msg types */
+                frame_filter &accept(int32_t msg_type)
+                {
+                    all_msg_types_ = false;
+                    if (msg_type >= 0 && msg_type < FRAME_FILTER_MSG_TYPE_LIMIT)
+                    {
+                        msg_types_.set(msg_type);
+                    }
+                    return *this;
+                }
+
+                /** accept only frames from given source */
+                frame_filter &from(uint32_t source)
+                {
+                    match_source_ = true;
+                    source_ = source;
+                    return *this;
+                }
+
+                /** accept only frames to given dest */
+                frame_filter &to(uint32_t dest)
+                {
+                    match_dest_ = true;
+                    dest_ = dest;
+                    return *this;
+                }
+
+                [[nodiscard]] bool accept_all() const
+                { return all_msg_types_ && !match_source_ && !match_dest_; }
+
+                [[nodiscard]] bool match(const frame_header *header) const
+                {
+                    int32_t msg_type = header->msg_type;
+                    return (all_msg_types_ || msg_type >= FRAME_FILTER_MSG_TYPE_LIMIT ||
+                            (msg_type >= 0 && msg_types_.test(msg_type))) &&
+                           (!match_source_ || header->source == source_) && (!match_dest_ || header->dest == dest_);
+                }
+
+            private:
+                std::bitset<FRAME_FILTER_MSG_TYPE_LIMIT> msg_types_;
+                bool all_msg_types_;
+                bool match_source_;
+                bool match_dest_;
+                uint32_t source_;
+                uint32_t dest_;
+            };
+
+            class frame_batch;
 
             /**
              * Journal class, the abstraction of continuous memory access
@@ -45,12 +147,14 @@ namespace kungfu
             public:
                 journal(data::location_ptr location, uint32_t dest_id, bool is_writing, bool lazy) :
                         location_(std::move(location)), dest_id_(dest_id), is_writing_(is_writing), lazy_(lazy),
-                        frame_(std::shared_ptr<frame>(new frame())), page_frame_nb_(0)
+                        page_provider_(is_writing ? std::make_shared<page_provider>(location_, dest_id, lazy) : nullptr),
+                        frame_(std::shared_ptr<frame>(new frame())), page_frame_nb_(0), readahead_(false)
                 {}
 
                 ~journal();
 
-                frame_ptr current_frame()
+                /** the frame object lives as long as the journal and moves along it, returned by reference to save refcounting */
+                const frame_ptr &current_frame()
                 { return frame_; }
 
                 /**
@@ -65,17 +169,36 @@ namespace kungfu
                  */
                 void seek_to_time(int64_t nanotime);
 
+                /**
+                 * makes sure after this call, current_frame() is the first writable frame after all existing ones,
+                 * regardless of their gen_time, resumes from page index, frame index and page header instead of scanning
+                 * @param frame_index sparse frame index of the resulting page, entries missing from file are recovered
+                 */
+                void seek_to_end(std::vector<frame_index_entry> &frame_index);
+
             private:
                 const data::location_ptr location_;
                 const uint32_t dest_id_;
                 const bool is_writing_;
                 const bool lazy_;
+                const page_provider_ptr page_provider_;
                 page_ptr current_page_;
                 frame_ptr frame_;
                 int page_frame_nb_;
+                frame_filter filter_;
+                bool readahead_;
 
                 void load_page(int page_id);
 
+                /** hint sequential access on current page, fault it in and prefetch next page file on helper thread */
+                void read_ahead();
+
+                /**
+                 * hand over a page this journal has consumed, its resident memory is dropped on readahead worker once
+                 * readahead of it is done, unless other readers still hold it
+                 */
+                static void drop_consumed(page_ptr &&page);
+
                 /** load next page, current page will be released if not empty */
                 void load_next_page();
 
@@ -84,10 +207,22 @@ namespace kungfu
                 friend class writer;
             };
 
+            /**
+             * Journal reader, merges joined journals by frame gen_time.
+             * Journals with data at head are kept in a min-heap keyed on head gen_time, only the journal just read is
+             * repositioned on next(). Journals without data are parked, each data_available() probes them with a length
+             * load before taking heap head, so frames are delivered in gen_time order across all journals.
+             */
             class reader
             {
             public:
-                explicit reader(bool lazy) : lazy_(lazy), current_(nullptr)
+                /**
+                 * @param lazy
+                 * @param readahead read pages ahead and drop consumed ones, for replay and backtest which read
+                 *                  journals sequentially from the past, only takes effect when lazy
+                 */
+                explicit reader(bool lazy, bool readahead = false) :
+                        lazy_(lazy), readahead_(readahead && lazy), current_(nullptr), now_(0)
                 {};
 
                 ~reader();
@@ -97,12 +232,14 @@ namespace kungfu
                  * @param location where the journal locates
                  * @param dest_id journal dest id
                  * @param from_time subscribe events after this time, 0 means from start
+                 * @param filter frames rejected by filter are skipped inside reader
                  */
-                void join(const data::location_ptr &location, uint32_t dest_id, int64_t from_time);
+                void join(const data::location_ptr &location, uint32_t dest_id, int64_t from_time,
+                          const frame_filter &filter = frame_filter());
 
                 void disjoin(uint32_t location_uid);
 
-                frame_ptr current_frame()
+                const frame_ptr &current_frame()
                 { return current_->current_frame(); }
 
                 bool data_available();
@@ -113,25 +250,57 @@ namespace kungfu
                 /** seek next frame */
                 void next();
 
+                /** rebuild merge heap from all joined journals */
                 void sort();
 
+                /** fill uids with locations of joined journals, each location once */
+                void get_location_uids(std::vector<uint32_t> &uids) const;
+
             private:
                 const bool lazy_;
+                const bool readahead_;
                 journal *current_;
                 std::vector<journal_ptr> journals_;
+                std::vector<journal *> heap_;
+                std::vector<journal *> parked_;
+                int64_t now_;
+
+                /** move parked journals that have data into heap */
+                void probe_parked();
+
+                /** move journal past frames rejected by its filter, returns whether it stops on data */
+                static bool skip_filtered(journal *j);
+
+                void push_heap(journal *j);
+
+                journal *pop_heap();
+
+                /** heap order, head gen_time of a is later than b */
+                static bool later(const journal *a, const journal *b);
             };
 
+            constexpr uint32_t WRITER_SPIN_LIMIT = 1024;
+
+            /**
+             * Journal writer, safe to share among multiple producer threads.
+             * write, write_raw, mark and their *_with_time variants reserve frame space with CAS on a shared cursor,
+             * fill data concurrently, then publish frames in reservation order by storing frame length last.
+             * open_frame/close_frame (and open_data/close_data) hold the writer exclusively in between.
+             */
             class writer
             {
             public:
                 writer(const data::location_ptr &location, uint32_t dest_id, bool lazy, publisher_ptr publisher);
 
+                ~writer();
+
                 const data::location_ptr &get_location() const
                 { return journal_->location_; }
 
                 uint32_t get_dest() const
                 { return journal_->dest_id_; }
 
+                /** uid of the frame being written, only meaningful between open_frame and close_frame */
                 uint64_t current_frame_uid();
 
                 frame_ptr open_frame(int64_t trigger_time, int32_t msg_type, uint32_t length);
@@ -140,7 +309,7 @@ namespace kungfu
 
                 void mark(int64_t trigger_time, int32_t msg_type);
 
-                void mark_with_time(int64_t trigger_time, int32_t msg_type);
+                void mark_with_time(int64_t gen_time, int32_t msg_type);
 
                 /**
                  * Using auto with the return mess up the reference with the undlerying memory address, DO NOT USE it.
@@ -167,43 +336,189 @@ namespace kungfu
                 template<typename T>
                 void write(int64_t trigger_time, int32_t msg_type, const T &data)
                 {
-                    auto frame = open_frame(trigger_time, msg_type, sizeof(T));
-                    close_frame(frame->copy_data<T>(data));
+                    write_raw(trigger_time, msg_type, reinterpret_cast<uintptr_t>(&data), sizeof(T));
                 }
 
                 template<typename T>
                 void write_with_time(int64_t gen_time, int32_t msg_type, const T &data)
                 {
-                    assert(sizeof(frame_header) + sizeof(T) + sizeof(frame_header) <= journal_->current_page_->get_page_size());
-                    if (journal_->current_frame()->address() + sizeof(frame_header) + sizeof(T) > journal_->current_page_->address_border())
-                    {
-                        mark(gen_time, msg::type::PageEnd);
-                        journal_->load_next_page();
-                    }
-                    auto frame = journal_->current_frame();
-                    frame->set_header_length();
-                    frame->set_trigger_time(0);
-                    frame->set_msg_type(msg_type);
-                    frame->set_source(journal_->location_->uid);
-                    frame->set_dest(journal_->dest_id_);
-
-                    frame->copy_data<T>(data);
-                    frame->set_gen_time(gen_time);
-                    frame->set_data_length(sizeof(T));
-                    journal_->current_page_->set_last_frame_position(frame->address() - journal_->current_page_->address());
-                    journal_->next();
+                    write_frame(0, msg_type, gen_time, reinterpret_cast<uintptr_t>(&data), sizeof(T));
                 }
 
                 void write_raw(int64_t trigger_time, int32_t msg_type, uintptr_t data, uint32_t length);
 
             private:
-                std::mutex writer_mtx_;
                 journal_ptr journal_;
                 uint64_t frame_id_base_;
                 publisher_ptr publisher_;
+                /** resolved once, closed pages are appended to it on page_persister thread */
+                std::string page_index_path_;
                 size_t size_to_write_;
+                /** position of next frame to reserve, (page_id << 32) | offset in page, 0 while writer is held exclusively */
+                std::atomic<uint64_t> reserve_cursor_;
+                /** position of next frame to publish, frames before it are all published */
+                std::atomic<uint64_t> commit_cursor_;
+                /** address of current page, only changes while writer is held exclusively */
+                std::atomic<uintptr_t> page_address_;
+                /** offset of current page border, only changes while writer is held exclusively */
+                std::atomic<uint32_t> page_border_;
 
                 void close_page(int64_t trigger_time);
+
+                /** reserve space for frame, rolls over to next page if needed, returns frame address */
+                uintptr_t reserve(uint32_t frame_length, int64_t trigger_time, uint64_t &position);
+
+                /** publish frame reserved at position once all frames before it are published, gen_time 0 means now */
+                void commit(uint64_t position, int64_t trigger_time, int32_t msg_type, int64_t gen_time, uint32_t data_length);
+
+                void write_frame(int64_t trigger_time, int32_t msg_type, int64_t gen_time, uintptr_t data, uint32_t length);
+
+                /** hold writer exclusively, returns when all reserved frames are published */
+                void acquire();
+
+                /** release writer held by acquire, reservations resume from current frame */
+                void release();
+
+                uintptr_t current_page_border() const
+                { return journal_->current_page_->address_border(); }
+
+                /** fill header of current frame */
+                frame_ptr init_frame(int64_t trigger_time, int32_t msg_type);
+
+                frame_ptr open_batch_frame(frame_batch &batch, int64_t trigger_time, int32_t msg_type, uint32_t length);
+
+                void close_batch_frame(frame_batch &batch, size_t data_length);
+
+                /** make frames written so far in batch visible to readers */
+                void publish_batch(frame_batch &batch);
+
+                void wait_commit(uint64_t position)
+                {
+                    uint32_t spins = 0;
+                    while (commit_cursor_.load(std::memory_order_acquire) != position)
+                    {
+                        backoff(spins);
+                    }
+                }
+
+                /** other producers may get preempted in the middle of a frame, give up cpu after spinning for a while */
+                static void backoff(uint32_t &spins)
+                {
+                    if (++spins > WRITER_SPIN_LIMIT)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+
+                /** record current frame into sparse frame index of current page, must be called before moving to next frame */
+                void index_frame()
+                {
+                    if (journal_->page_frame_nb_ % FRAME_INDEX_INTERVAL == 0)
+                    {
+                        auto &frame = journal_->current_frame();
+                        frame_index_entry entry = {};
+                        entry.frame_nb = journal_->page_frame_nb_;
+                        entry.position = frame->address() - journal_->current_page_->address();
+                        entry.gen_time = frame->gen_time();
+                        journal_->current_page_->index_frame(entry);
+                    }
+                }
+
+                friend class frame_batch;
+
+                friend class frame_builder;
+            };
+
+            /**
+             * Writes frames contiguously while holding the writer exclusively, frames become visible to readers all at once
+             * on commit, with a single page header update and a single notification.
+             * Commits on destruction if not committed explicitly.
+             */
+            class frame_batch
+            {
+            public:
+                explicit frame_batch(writer_ptr writer);
+
+                ~frame_batch();
+
+                frame_batch(const frame_batch &) = delete;
+
+                frame_batch &operator=(const frame_batch &) = delete;
+
+                frame_ptr open_frame(int64_t trigger_time, int32_t msg_type, uint32_t length)
+                { return writer_->open_batch_frame(*this, trigger_time, msg_type, length); }
+
+                void close_frame(size_t data_length)
+                { writer_->close_batch_frame(*this, data_length); }
+
+                template<typename T>
+                void write(int64_t trigger_time, int32_t msg_type, const T &data)
+                {
+                    write_raw(trigger_time, msg_type, reinterpret_cast<uintptr_t>(&data), sizeof(T));
+                }
+
+                void write_raw(int64_t trigger_time, int32_t msg_type, uintptr_t data, uint32_t length);
+
+                void mark(int64_t trigger_time, int32_t msg_type)
+                { write_raw(trigger_time, msg_type, 0, 0); }
+
+                /** make all frames visible to readers, notify once and release the writer */
+                void commit();
+
+            private:
+                writer_ptr writer_;
+                bool committed_;
+                size_t frame_count_;
+                /** first frame not yet visible to readers, its length is withheld until publish, 0 if none */
+                uintptr_t pending_address_;
+                uint32_t pending_length_;
+                uintptr_t last_frame_address_;
+
+                friend class writer;
+
+                friend class frame_builder;
+            };
+
+            /**
+             * Streambuf over data of a frame being written, lets serializers write straight into journal memory, e.g.
+             * std::ostream(&builder) << json, or fmt::format_to(std::ostreambuf_iterator<char>(&builder), ...).
+             * Only the length actually written is committed, up to max_length, no space is set aside beforehand.
+             * Data written so far is moved to next page if page border is reached before max_length.
+             * Writing beyond max_length fails the builder, a failed frame is dropped on commit rather than published truncated.
+             * Holds the writer exclusively (or works within a batch) until commit, commits on destruction.
+             */
+            class frame_builder : public std::streambuf
+            {
+            public:
+                frame_builder(writer_ptr writer, int64_t trigger_time, int32_t msg_type, uint32_t max_length);
+
+                frame_builder(frame_batch &batch, int64_t trigger_time, int32_t msg_type, uint32_t max_length);
+
+                ~frame_builder() override;
+
+                /** length of data written so far */
+                [[nodiscard]] uint32_t length() const
+                { return pptr() - pbase(); }
+
+                /** whether data exceeded max_length or did not fit in a page, the frame will not be published */
+                [[nodiscard]] bool failed() const
+                { return failed_; }
+
+                void commit();
+
+            protected:
+                int_type overflow(int_type ch) override;
+
+            private:
+                writer_ptr writer_;
+                frame_batch *batch_;
+                frame_ptr frame_;
+                const int64_t trigger_time_;
+                const uint32_t max_length_;
+                bool committed_;
+                bool failed_;
+
+                void reset_put_area(frame_ptr frame);
             };
         }
     }
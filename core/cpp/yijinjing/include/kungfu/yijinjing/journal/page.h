@@ -16,9 +16,21 @@
 #ifndef YIJINJING_PAGE_H
 #define YIJINJING_PAGE_H
 
+#include <vector>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
 #include <kungfu/yijinjing/journal/common.h>
 #include <kungfu/yijinjing/journal/frame.h>
 
+#define HUGE_PAGE_ENV "KF_HUGE_PAGE"
+#define SHM_JOURNAL_ENV "KF_SHM_JOURNAL"
+#define SHM_JOURNAL_DIR "/dev/shm/kungfu"
+
 namespace kungfu
 {
     namespace yijinjing
@@ -40,11 +52,16 @@ namespace kungfu
 #pragma pack(pop)
 #endif
 
+            struct frame_index_entry;
+
             class page
             {
             public:
                 ~page();
 
+                [[nodiscard]] uint32_t get_version() const
+                { return header_->version; }
+
                 [[nodiscard]] uint32_t get_page_size() const
                 { return header_->page_size; }
 
@@ -57,6 +74,14 @@ namespace kungfu
                 [[nodiscard]] int get_page_id() const
                 { return page_id_; }
 
+                /** file the page is mapped from */
+                [[nodiscard]] const std::string &get_path() const
+                { return path_; }
+
+                /** whether the page is a memory resident copy under SHM_JOURNAL_DIR */
+                [[nodiscard]] bool is_in_shm() const
+                { return path_.rfind(SHM_JOURNAL_DIR, 0) == 0; }
+
                 [[nodiscard]] int64_t begin_time() const
                 { return reinterpret_cast<frame_header *>(first_frame_address())->gen_time; }
 
@@ -80,31 +105,370 @@ namespace kungfu
 
                 static page_ptr load(const data::location_ptr& location, uint32_t dest_id, int page_id, bool is_writing, bool lazy);
 
+                /**
+                 * load page from path, huge page option and new page size already resolved by the caller, does not call into locator,
+                 * thus safe to use on threads other than the one owning locator (which may need python GIL).
+                 * page size in header of existing page always takes precedence over new_page_size.
+                 * when is_writing, frame index of the page is mapped from frame_index_path as well.
+                 */
+                static page_ptr load(const data::location_ptr& location, uint32_t dest_id, int page_id, const std::string &path,
+                                     const std::string &frame_index_path, bool is_writing, bool lazy, bool huge_page,
+                                     uint32_t new_page_size);
+
+                /**
+                 * whether pages of given location should be backed by huge pages, enabled per category by
+                 * env KF_HUGE_PAGE, a comma separated list of category names, e.g. "md,strategy"
+                 */
+                static bool use_huge_page(const data::location_ptr& location);
+
+                /**
+                 * whether live pages of given location are kept in memory under SHM_JOURNAL_DIR and persisted to the
+                 * durable journal directory once closed, enabled per category by env KF_SHM_JOURNAL, e.g. "td,strategy"
+                 */
+                static bool use_shm(const data::location_ptr& location);
+
+                /** path of page under journal directory of locator */
+                static std::string get_durable_page_path(const data::location_ptr& location, uint32_t dest_id, int id);
+
+                /** path of page under SHM_JOURNAL_DIR */
+                static std::string get_shm_page_path(const data::location_ptr& location, uint32_t dest_id, int id);
+
+                /**
+                 * path to map page from. for shm journals it is the memory resident copy if present, otherwise the
+                 * durable copy if present (persisted page, or live page left when memory resident copy is gone),
+                 * otherwise the memory resident path of a page yet to come
+                 */
                 static std::string get_page_path(const data::location_ptr& location, uint32_t dest_id, int id);
 
-                static int find_page_id(const data::location_ptr& location, uint32_t dest_id, int64_t time);
+                static int find_page_id(const data::location_ptr& location, uint32_t dest_id, int64_t time, bool is_writing = false);
 
             private:
 
                 const data::location_ptr location_;
                 const uint32_t dest_id_;
                 const int page_id_;
+                const std::string path_;
                 const bool lazy_;
                 const size_t size_;
                 const page_header *header_;
+                /** whether memory of the page was locked when mapped, see os::set_page_locking */
+                bool locked_;
+                /** mapped frame index, only for pages being written, 0 otherwise */
+                uintptr_t frame_index_address_;
+                uint32_t frame_index_capacity_;
 
-                page(const data::location_ptr& location, uint32_t dest_id, int page_id, size_t size, bool lazy, uintptr_t address);
+                page(const data::location_ptr& location, uint32_t dest_id, int page_id, std::string path, size_t size, bool lazy,
+                     uintptr_t address);
 
                 /**
                  * update page header when new frame added
                  */
                 void set_last_frame_position(uint64_t position);
 
+                /** write entry into mapped frame index at the slot of its frame number, visible to readers at once */
+                void index_frame(const frame_index_entry &entry);
+
+                /** rewrite mapped frame index with given entries, slots beyond them are cleared */
+                void restore_frame_index(const std::vector<frame_index_entry> &entries);
+
                 friend class journal;
                 friend class writer;
                 friend class reader;
+                friend class page_index;
+                friend class page_cache;
+            };
+
+            constexpr size_t PAGE_RECLAIM_QUEUE_SIZE = 64;
+
+            /**
+             * Releases (munlock + munmap) retired pages on a background thread, so that journals moving to next page
+             * do not pay for it on the hot path. Pages are released in place if the queue is full.
+             */
+            class page_reclaimer
+            {
+            public:
+                static page_reclaimer &instance();
+
+                /**
+                 * hand off a page no longer used by the caller, the page is released once all other references are gone
+                 * @param page
+                 */
+                void retire(page_ptr &&page);
+
+                /** number of pages handed off */
+                [[nodiscard]] uint64_t get_retired_count() const
+                { return retired_count_; }
+
+                /** number of pages released on background thread */
+                [[nodiscard]] uint64_t get_reclaimed_count() const
+                { return reclaimed_count_; }
+
+                /** number of pages released in place because queue was full */
+                [[nodiscard]] uint64_t get_overflow_count() const
+                { return overflow_count_; }
+
+                /** highest queue depth seen */
+                [[nodiscard]] uint64_t get_max_queue_depth() const
+                { return max_queue_depth_; }
+
+                /** time spent on releasing pages in background, in nanoseconds */
+                [[nodiscard]] int64_t get_reclaim_time() const
+                { return reclaim_time_; }
+
+            private:
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::deque<page_ptr> queue_;
+                std::atomic<uint64_t> retired_count_;
+                std::atomic<uint64_t> reclaimed_count_;
+                std::atomic<uint64_t> overflow_count_;
+                std::atomic<uint64_t> max_queue_depth_;
+                std::atomic<int64_t> reclaim_time_;
+
+                page_reclaimer();
+
+                void run();
+            };
+
+#ifdef _WIN32
+#pragma  pack(push, 1)
+#endif
+            struct page_index_entry
+            {
+                int32_t page_id;
+                /** number of frames in page, PageEnd excluded, 0 if unknown */
+                uint32_t frame_count;
+                /** gen_time of the first frame */
+                int64_t begin_time;
+                /** gen_time of the PageEnd frame */
+                int64_t end_time;
+#ifndef _WIN32
+            } __attribute__((packed));
+#else
+            };
+#pragma pack(pop)
+#endif
+
+            /** number of newer closed pages persisted before memory resident copy of a page is removed */
+            constexpr int SHM_PAGE_RETAIN = 2;
+
+            /**
+             * Copies closed pages of shm journals to their durable path on a background thread, readers lagging behind
+             * keep finding the memory resident copy until SHM_PAGE_RETAIN newer pages are persisted.
+             * Page index entries of closed pages are appended on the same thread, in order of submission.
+             */
+            class page_persister
+            {
+            public:
+                static page_persister &instance();
+
+                /**
+                 * queue page for persistence, the page stays mapped until copied
+                 * @param page closed page
+                 * @param durable_path where to copy to
+                 * @param retired_path memory resident page to remove once copied, empty for none
+                 */
+                void persist(page_ptr page, std::string durable_path, std::string retired_path);
+
+                /**
+                 * queue entry to be appended to page index
+                 * @param index_path resolved by caller, see page_index::get_index_path
+                 * @param entry
+                 */
+                void append_index(std::string index_path, const page_index_entry &entry);
+
+                /** block until queued pages are persisted and queued index entries appended */
+                void flush();
+
+                /** copy page content up to its last frame to durable path, through a temporary file then rename */
+                static void copy(const page_ptr &page, const std::string &durable_path);
+
+                [[nodiscard]] uint64_t get_persisted_count() const
+                { return persisted_count_; }
+
+                /** time spent on copying pages in background, in nanoseconds */
+                [[nodiscard]] int64_t get_persist_time() const
+                { return persist_time_; }
+
+            private:
+                struct task
+                {
+                    /** page to persist, null for index only tasks */
+                    page_ptr page;
+                    std::string durable_path;
+                    std::string retired_path;
+                    /** index to append index_entry to, empty for page only tasks */
+                    std::string index_path;
+                    page_index_entry index_entry;
+                };
+
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::condition_variable flushed_cv_;
+                std::deque<task> queue_;
+                bool busy_;
+                std::atomic<uint64_t> persisted_count_;
+                std::atomic<int64_t> persist_time_;
+
+                page_persister();
+
+                void run();
+            };
+
+            /** default bytes of idle pages page_cache may keep mapped */
+            constexpr size_t PAGE_CACHE_BUDGET = 1024 * size_t(MB);
+
+            /**
+             * Process wide cache of pages mapped for reading, keyed by (location uid, dest id, page id), so that readers of
+             * the same journal share one mapping. Pages in use are always kept, idle pages (referenced only by the cache)
+             * are unmapped in LRU order once mapped bytes exceed the budget. Idle locked pages are not kept at all, they
+             * would pin memory the kernel can not reclaim.
+             */
+            class page_cache
+            {
+            public:
+                static page_cache &instance();
+
+                /**
+                 * get page for reading, mapping it if not cached yet.
+                 * a cached lazy mapping is replaced when a non-lazy one is asked for.
+                 */
+                page_ptr load(const data::location_ptr &location, uint32_t dest_id, int page_id, bool lazy);
+
+                void set_budget(size_t budget);
+
+                [[nodiscard]] size_t get_budget() const
+                { return budget_; }
+
+                [[nodiscard]] uint64_t get_hit_count() const
+                { return hit_count_; }
+
+                [[nodiscard]] uint64_t get_miss_count() const
+                { return miss_count_; }
+
+                [[nodiscard]] uint64_t get_evicted_count() const
+                { return evicted_count_; }
+
+                [[nodiscard]] double get_hit_rate() const;
+
+                /** bytes of all cached pages, in use or idle */
+                [[nodiscard]] size_t get_mapped_bytes() const
+                { return mapped_bytes_; }
+
+                [[nodiscard]] size_t get_page_count();
+
+            private:
+                struct key
+                {
+                    uint32_t location_uid;
+                    uint32_t dest_id;
+                    int page_id;
+
+                    bool operator==(const key &other) const
+                    { return location_uid == other.location_uid && dest_id == other.dest_id && page_id == other.page_id; }
+                };
+
+                struct key_hash
+                {
+                    size_t operator()(const key &k) const
+                    { return (size_t(k.location_uid) << 32u | k.dest_id) ^ (size_t(k.page_id) * 0x9e3779b97f4a7c15ull); }
+                };
+
+                struct entry
+                {
+                    page_ptr page;
+                    std::list<key>::iterator lru_position;
+                };
+
+                std::mutex mutex_;
+                /** most recently used first */
+                std::list<key> lru_;
+                std::unordered_map<key, entry, key_hash> entries_;
+                std::atomic<size_t> budget_;
+                std::atomic<size_t> mapped_bytes_;
+                std::atomic<uint64_t> hit_count_;
+                std::atomic<uint64_t> miss_count_;
+                std::atomic<uint64_t> evicted_count_;
+
+                page_cache();
+
+                /** drop idle locked pages, and idle pages from the tail of lru until within budget, caller must hold mutex_ */
+                void evict(std::vector<page_ptr> &evicted);
+            };
+
+            /**
+             * Per (location, dest) index of closed pages, appended on page_persister thread when writer closes a page,
+             * so that seeking by time does not need to list and mmap every page.
+             */
+            class page_index
+            {
+            public:
+                static std::string get_index_path(const data::location_ptr &location, uint32_t dest_id);
+
+                /**
+                 * load index entries of closed pages, sorted by page id.
+                 * index will be rebuilt from page files if it is missing or stale (legacy journals),
+                 * the rebuilt index is only persisted when is_writing.
+                 */
+                static std::vector<page_index_entry> load(const data::location_ptr &location, uint32_t dest_id, bool is_writing);
+
+                static std::vector<page_index_entry> rebuild(const data::location_ptr &location, uint32_t dest_id, bool persist);
+
+                static void append(const std::string &index_path, const page_index_entry &entry);
+
+                /**
+                 * binary search the page which holds the first frame with gen_time > time
+                 * @return page id, the page after the last indexed one if time is beyond all closed pages
+                 */
+                static int find_page_id(const std::vector<page_index_entry> &entries, int64_t time);
+            };
+
+            /** writer records one frame in every FRAME_INDEX_INTERVAL frames into the sparse frame index of page */
+            constexpr uint32_t FRAME_INDEX_INTERVAL = 256;
+
+#ifdef _WIN32
+#pragma  pack(push, 1)
+#endif
+            struct frame_index_entry
+            {
+                /** frame number within page */
+                uint32_t frame_nb;
+                /** frame position relative to page address */
+                uint32_t position;
+                int64_t gen_time;
+#ifndef _WIN32
+            } __attribute__((packed));
+#else
+            };
+#pragma pack(pop)
+#endif
+
+            /**
+             * Sparse per page index of frame positions by gen_time, so that seeking into the middle of a page only walks
+             * a few frames. Writer maps it along with the page and stores entries straight into it, so the index of the
+             * live page is readable at any time. Entry i describes frame number i * FRAME_INDEX_INTERVAL, unused slots
+             * at the end are zero.
+             */
+            class frame_index
+            {
+            public:
+                static std::string get_index_path(const data::location_ptr &location, uint32_t dest_id, int page_id);
+
+                /** number of slots needed for a page of given size, enough for a page full of empty frames */
+                static uint32_t capacity(uint32_t page_size)
+                { return page_size / (FRAME_INDEX_INTERVAL * sizeof(frame_header)) + 1; }
+
+                /** load entries written so far, unused slots excluded */
+                static std::vector<frame_index_entry> load(const data::location_ptr &location, uint32_t dest_id, int page_id);
+
+                /**
+                 * binary search the last indexed frame with gen_time <= time
+                 * @return pointer to the entry, nullptr if time is before all indexed frames
+                 */
+                static const frame_index_entry *find(const std::vector<frame_index_entry> &entries, int64_t time);
             };
 
+            /** default page size policy, see data::locator::page_size */
             inline static uint32_t find_page_size(const data::location_ptr& location, uint32_t dest_id)
             {
                 if (location->category == data::category::MD && dest_id == 0)
@@ -35,6 +35,18 @@ namespace kungfu
                 };
             }
 
+            /**
+             * maps a msg data struct to its msg type at compile time, left undefined for types without a fixed layout,
+             * so that subscribing or casting with an unmapped struct fails to compile
+             */
+            template<typename T>
+            struct msg_traits;
+
+#define DECLARE_MSG_TYPE(data_type, msg_type) \
+            template<> \
+            struct kungfu::yijinjing::msg::msg_traits<data_type> \
+            { static constexpr int32_t type = msg_type; };
+
             namespace data
             {
 #ifdef _WIN32
@@ -94,4 +106,10 @@ namespace kungfu
         }
     }
 }
+
+DECLARE_MSG_TYPE(kungfu::yijinjing::msg::data::TimeRequest, kungfu::yijinjing::msg::type::TimeRequest)
+DECLARE_MSG_TYPE(kungfu::yijinjing::msg::data::RequestReadFrom, kungfu::yijinjing::msg::type::RequestReadFrom)
+DECLARE_MSG_TYPE(kungfu::yijinjing::msg::data::RequestWriteTo, kungfu::yijinjing::msg::type::RequestWriteTo)
+DECLARE_MSG_TYPE(kungfu::yijinjing::msg::data::Channel, kungfu::yijinjing::msg::type::Channel)
+
 #endif //KUNGFU_YIJINJING_MSG_H
@@ -6,6 +6,7 @@
 #define KUNGFU_NANOMSG_SOCKET_H
 
 #include <string>
+#include <vector>
 #include <cstring>
 #include <algorithm>
 #include <exception>
@@ -180,23 +181,35 @@ namespace kungfu
             class nanomsg_json : public event
             {
             public:
-                nanomsg_json(const std::string &msg) : binding_(nlohmann::json::parse(msg)), msg_(msg)
-                {};
+                nanomsg_json(const std::string &msg)
+                { reset(msg); };
+
+                /** rebind to another message, meta fields are looked up once here instead of on every access */
+                void reset(const std::string &msg)
+                {
+                    binding_ = nlohmann::json::parse(msg);
+                    msg_ = msg;
+                    gen_time_ = get_meta<int64_t>("gen_time", 0);
+                    trigger_time_ = get_meta<int64_t>("trigger_time", 0);
+                    msg_type_ = get_meta<int32_t>("msg_type", 0);
+                    source_ = get_meta<uint32_t>("source", 0);
+                    dest_ = get_meta<uint32_t>("dest", 0);
+                }
 
                 int64_t gen_time() const override
-                { return get_meta<int64_t>("gen_time", 0); }
+                { return gen_time_; }
 
                 int64_t trigger_time() const override
-                { return get_meta<int64_t>("trigger_time", 0); }
+                { return trigger_time_; }
 
                 int32_t msg_type() const override
-                { return get_meta<int32_t>("msg_type", 0); }
+                { return msg_type_; }
 
                 uint32_t source() const override
-                { return get_meta<uint32_t>("source", 0); }
+                { return source_; }
 
                 uint32_t dest() const override
-                { return get_meta<uint32_t>("dest", 0); }
+                { return dest_; }
 
                 uint32_t data_length() const override
                 { return binding_.size(); }
@@ -215,24 +228,66 @@ namespace kungfu
                 { return &binding_["data"]; }
 
             private:
-                const nlohmann::json binding_;
-                const std::string msg_;
+                nlohmann::json binding_;
+                std::string msg_;
+                int64_t gen_time_;
+                int64_t trigger_time_;
+                int32_t msg_type_;
+                uint32_t source_;
+                uint32_t dest_;
 
                 template<typename T>
-                T get_meta(const std::string &name, T default_value) const
+                T get_meta(const char *name, T default_value) const
                 {
-                    if (binding_.find(name) == binding_.end())
+                    auto it = binding_.find(name);
+                    if (it == binding_.end())
                     {
                         return default_value;
                     } else
                     {
-                        T value = binding_[name];
+                        T value = *it;
                         return value;
                     }
                 }
             };
 
             DECLARE_PTR(nanomsg_json)
+
+            /**
+             * Recycles nanomsg_json events no longer held outside the pool, so that notices and requests do not cost
+             * an event allocation each, falls back to a fresh event when all pooled ones are still in use
+             */
+            class nanomsg_json_pool
+            {
+            public:
+                explicit nanomsg_json_pool(size_t capacity = 64) : capacity_(capacity), cursor_(0)
+                {}
+
+                event_ptr acquire(const std::string &msg)
+                {
+                    for (size_t i = 0; i < events_.size(); i++)
+                    {
+                        auto &event = events_[cursor_];
+                        cursor_ = (cursor_ + 1) % events_.size();
+                        if (event.use_count() == 1)
+                        {
+                            event->reset(msg);
+                            return event;
+                        }
+                    }
+                    auto event = std::make_shared<nanomsg_json>(msg);
+                    if (events_.size() < capacity_)
+                    {
+                        events_.push_back(event);
+                    }
+                    return event;
+                }
+
+            private:
+                const size_t capacity_;
+                size_t cursor_;
+                std::vector<nanomsg_json_ptr> events_;
+            };
         }
     }
 }
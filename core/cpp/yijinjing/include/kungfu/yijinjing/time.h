@@ -17,6 +17,7 @@
 #define YIJINJING_TIMER_H
 
 #include <string>
+#include <atomic>
 
 #define KUNGFU_DATETIME_FORMAT_DEFAULT "%F %T.%N"
 
@@ -49,6 +50,7 @@ namespace kungfu {
         public:
 
             /**
+             * read from calibrated tsc where cpu has invariant tsc, otherwise from steady clock
              * @return current nano time in int64_t (unix-timestamp * 1e9 + nano-part)
              */
             static int64_t now_in_nano();
@@ -69,6 +71,27 @@ namespace kungfu {
              */
             static const std::string strftime(const int64_t nanotime, const std::string &format=KUNGFU_DATETIME_FORMAT_DEFAULT);
 
+            /**
+             * fast path for broker time fields in local time, midnight of the date is cached per thread
+             * @param date yyyymmdd, e.g. CTP ActionDay "20190614"
+             * @param time_of_day HH:MM:SS, e.g. CTP UpdateTime "09:30:00"
+             * @return nano time in int64_t
+             */
+            static int64_t nano_from_date_time(const char *date, const char *time_of_day, int millisecond = 0);
+
+            /**
+             * fast path for numeric broker time fields in local time, midnight of the date is cached per thread
+             * @return nano time in int64_t
+             */
+            static int64_t nano_from_date_time(int year, int month, int day, int hour, int minute, int second, int64_t nanosecond = 0);
+
+            /**
+             * write local date of nanotime as yyyymmdd, same as strftime(nanotime, "%Y%m%d") without allocation,
+             * the date is cached per thread until next midnight
+             * @param buffer at least 9 chars, null terminated on return
+             */
+            static void strfday(int64_t nanotime, char *buffer);
+
             static inline const std::string strfnow(const std::string &format=KUNGFU_DATETIME_FORMAT_DEFAULT)
             {
                 return strftime(now_in_nano(), format);
@@ -92,10 +115,36 @@ namespace kungfu {
 
         private:
             time();
-            static const time& get_instance();
+            static time& get_instance();
 
             int64_t start_time_since_epoch_;
             int64_t start_time_steady_;
+
+            /**
+             * tsc ticks map to nano time by nano_base + (ticks - tsc_base) * multiplier >> TSC_SHIFT for one calibration
+             * interval, by the plain rate beyond it so that a slew is never applied longer than meant,
+             * guarded by a sequence lock, recalibrated against steady clock by whichever thread finds it due
+             */
+            bool use_tsc_;
+            int64_t tsc_start_;
+            int64_t tsc_start_nano_;
+            int64_t tsc_calibration_ticks_;
+            std::atomic<uint32_t> tsc_sequence_;
+            std::atomic<int64_t> tsc_base_;
+            std::atomic<int64_t> tsc_nano_base_;
+            std::atomic<int64_t> tsc_multiplier_;
+            std::atomic<int64_t> tsc_rate_;
+            std::atomic_flag tsc_calibrating_ = ATOMIC_FLAG_INIT;
+
+            int64_t steady_now_in_nano() const;
+
+            int64_t tsc_now_in_nano();
+
+            int64_t tsc_to_nano(int64_t tsc, int64_t tsc_base, int64_t nano_base, int64_t multiplier, int64_t rate) const;
+
+            void calibrate_tsc(int64_t tsc_base, int64_t nano_base, int64_t multiplier, int64_t plain_rate);
+
+            void publish_tsc_calibration(int64_t tsc_base, int64_t nano_base, int64_t multiplier, int64_t rate);
         };
     }
 }
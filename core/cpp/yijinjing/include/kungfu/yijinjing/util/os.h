@@ -6,6 +6,8 @@
 #define KUNGFU_YIJINJING_OS_H
 
 #include <string>
+#include <vector>
+#include <cstdint>
 #include <initializer_list>
 
 namespace kungfu
@@ -17,13 +19,80 @@ namespace kungfu
             /**
              * load mmap buffer, return address of the file-mapped memory
              * whether to write has to be specified in "is_writing"
-             * buffer memory is locked if not lazy
+             * buffer is advised for random access if not lazy, and locked (thus prefaulted) if journal page locking is on
+             * if huge_page, buffer is aligned to and advised for transparent huge pages (linux only, silently falls back),
+             * files on hugetlbfs are always backed by huge pages and require size to be a multiple of the huge page size
              * @return the address of mapped memory
              */
-            uintptr_t load_mmap_buffer(const std::string &path, size_t size, bool is_writing = false, bool lazy = true);
+            uintptr_t load_mmap_buffer(const std::string &path, size_t size, bool is_writing = false, bool lazy = true, bool huge_page = false);
 
             bool release_mmap_buffer(uintptr_t address, size_t size, bool lazy);
 
+            enum class mmap_advice
+            {
+                SEQUENTIAL,
+                WILLNEED,
+                DONTNEED
+            };
+
+            /**
+             * hint kernel about how mapped buffer is going to be accessed, no-op where not supported
+             * DONTNEED on a shared file mapping only drops resident pages, content is read back from file on next access
+             */
+            bool advise_mmap_buffer(uintptr_t address, size_t size, mmap_advice advice);
+
+            /**
+             * ask kernel to read file into page cache in background, no-op where not supported
+             */
+            bool prefetch_file(const std::string &path);
+
+            /**
+             * wait while word at address equals expected, for at most timeout_ms, address may be in memory shared
+             * among processes, falls back to sleeping where futex is not available
+             * @return true if woken up, false if timed out or word already differs from expected
+             */
+            bool futex_wait(const volatile uint32_t *address, uint32_t expected, int timeout_ms);
+
+            /** wake up all waiters on address */
+            void futex_wake(const volatile uint32_t *address);
+
+            /** hint cpu that caller is in a spin loop */
+            inline void cpu_relax()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#elif defined(__aarch64__)
+                asm volatile("yield");
+#endif
+            }
+
+            /** lock and prefault every journal page mapped from now on, failures are warned and the page left unlocked */
+            void set_page_locking(bool locking);
+
+            bool is_page_locking();
+
+            /** scheduling and memory policy of a kungfu process */
+            struct runtime_policy
+            {
+                /** cpus the calling thread is pinned to, empty leaves affinity as is */
+                std::vector<int> cpu_affinity;
+                /** SCHED_FIFO priority of the calling thread, 0 leaves normal scheduling */
+                int rt_priority = 0;
+                /** lock all current mappings and lock journal pages mapped later */
+                bool lock_memory = false;
+                /** settings which could not be parsed, reported along with what was applied */
+                std::vector<std::string> errors;
+            };
+
+            /**
+             * apply policy to calling thread and process, failures do not throw
+             * @return human readable report of what was applied and what failed
+             */
+            std::string apply_runtime_policy(const runtime_policy &policy);
+
+            /** give calling thread normal scheduling and the cpus process had before any runtime policy, for helper threads */
+            void reset_thread_policy();
+
             void handle_os_signals(void *hero);
         }
     }
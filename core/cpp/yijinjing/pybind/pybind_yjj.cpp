@@ -69,6 +69,11 @@ class PyLocator : public data::locator
     {
         PYBIND11_OVERLOAD_PURE(const std::vector<int>, data::locator, list_page_id, location, dest_id)
     }
+
+    uint32_t page_size(data::location_ptr location, uint32_t dest_id) const override
+    {
+        PYBIND11_OVERLOAD(uint32_t, data::locator, page_size, location, dest_id);
+    }
 };
 
 class PyEvent : public event
@@ -252,7 +257,8 @@ PYBIND11_MODULE(pyyjj, m)
             .def("get_env", &data::locator::get_env)
             .def("layout_dir", &data::locator::layout_dir)
             .def("layout_file", &data::locator::layout_file)
-            .def("list_page_id", &data::locator::list_page_id);
+            .def("list_page_id", &data::locator::list_page_id)
+            .def("page_size", &data::locator::page_size);
 
     py::enum_<nanomsg::protocol>(m, "protocol", py::arithmetic(), "Nanomsg Protocol")
             .value("REPLY", nanomsg::protocol::REPLY)
@@ -280,17 +286,46 @@ PYBIND11_MODULE(pyyjj, m)
             .def("publish", &publisher::publish)
             .def("notify", &publisher::notify);
 
+    py::class_<wait_strategy>(m, "wait_strategy")
+            .def(py::init<>())
+            .def_readwrite("spin_us", &wait_strategy::spin_us)
+            .def_readwrite("yield_us", &wait_strategy::yield_us)
+            .def_readwrite("block_ms", &wait_strategy::block_ms);
+
+    py::class_<wait_stats>(m, "wait_stats")
+            .def_readonly("idle_count", &wait_stats::idle_count)
+            .def_readonly("spin_wakeup_count", &wait_stats::spin_wakeup_count)
+            .def_readonly("yield_wakeup_count", &wait_stats::yield_wakeup_count)
+            .def_readonly("block_wakeup_count", &wait_stats::block_wakeup_count)
+            .def_readonly("timeout_count", &wait_stats::timeout_count)
+            .def_readonly("spin_time", &wait_stats::spin_time)
+            .def_readonly("block_time", &wait_stats::block_time)
+            .def_readonly("wakeup_latency_max", &wait_stats::wakeup_latency_max)
+            .def_property_readonly("wakeup_count", &wait_stats::get_wakeup_count)
+            .def_property_readonly("wakeup_latency_mean", &wait_stats::get_wakeup_latency_mean);
+
     py::class_<observer, PyObserver, observer_ptr>(m, "observer")
             .def("wait", &observer::wait)
-            .def("get_notice", &observer::get_notice);
+            .def("get_notice", &observer::get_notice)
+            .def_property("wait_strategy", &observer::get_wait_strategy, &observer::set_wait_strategy)
+            .def_property_readonly("wait_stats", &observer::get_wait_stats);
+
+    py::class_<frame_filter>(m, "frame_filter")
+            .def(py::init<>())
+            .def("accept", &frame_filter::accept, py::arg("msg_type"), py::return_value_policy::reference_internal)
+            .def("from_source", &frame_filter::from, py::arg("source"), py::return_value_policy::reference_internal)
+            .def("to_dest", &frame_filter::to, py::arg("dest"), py::return_value_policy::reference_internal)
+            .def("accept_all", &frame_filter::accept_all);
 
     py::class_<reader, reader_ptr>(m, "reader")
-            .def("subscribe", &reader::join)
+            .def("subscribe", &reader::join, py::arg("location"), py::arg("dest_id"), py::arg("from_time"),
+                 py::arg("filter") = frame_filter())
             .def("current_frame", &reader::current_frame)
             .def("seek_to_time", &reader::seek_to_time)
             .def("data_available", &reader::data_available)
             .def("next", &reader::next)
-            .def("join", &reader::join)
+            .def("join", &reader::join, py::arg("location"), py::arg("dest_id"), py::arg("from_time"),
+                 py::arg("filter") = frame_filter())
             .def("disjoin", &reader::disjoin);
 
     py::class_<writer, writer_ptr>(m, "writer")
@@ -308,6 +343,8 @@ PYBIND11_MODULE(pyyjj, m)
     io_device.def(py::init<data::location_ptr, bool, bool>(), py::arg("location"), py::arg("low_latency") = false, py::arg("lazy") = true)
             .def_property_readonly("publisher", &io_device::get_publisher)
             .def_property_readonly("observer", &io_device::get_observer)
+            .def_property_readonly("wait_stats", &io_device::get_wait_stats)
+            .def("set_wait_strategy", &io_device::set_wait_strategy)
             .def_property_readonly("home", &io_device::get_home)
             .def_property_readonly("live_home", &io_device::get_live_home)
             .def("open_reader", &io_device::open_reader)
@@ -341,6 +378,7 @@ PYBIND11_MODULE(pyyjj, m)
             .def_property_readonly("io_device", &apprentice::get_io_device)
             .def("set_begin_time", &apprentice::set_begin_time)
             .def("set_end_time", &apprentice::set_end_time)
+            .def("declare_interest", &apprentice::declare_interest)
             .def("on_trading_day", &apprentice::on_trading_day)
             .def("run", &apprentice::run);
 
@@ -15,6 +15,12 @@
 
 #include <utility>
 #include <typeinfo>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <vector>
 #include <spdlog/spdlog.h>
 #include <nanomsg/nn.h>
 #include <nanomsg/reqrep.h>
@@ -24,6 +30,7 @@
 
 #include <kungfu/yijinjing/util/util.h>
 #include <kungfu/yijinjing/util/os.h>
+#include <kungfu/yijinjing/time.h>
 #include <kungfu/yijinjing/io.h>
 
 using namespace kungfu::yijinjing;
@@ -50,6 +57,244 @@ namespace kungfu
             }
         };
 
+#ifdef __linux__
+        constexpr size_t NOTICE_BLOCK_SIZE = 4096;
+
+        /** idle observers a notice block keeps track of at most, others fall back to block_ms timeouts */
+        constexpr uint32_t NOTICE_WATCHER_SLOTS = 64;
+
+        /** notice blocks a process maps at most */
+        constexpr uint32_t NOTICE_BOARD_CAPACITY = 1024;
+
+        /**
+         * Notice block of one location, mapped from <uid>.notice in master journal dir by every process under the home.
+         * The doorbell is rung for the observer whose home is this location, it waits on the sequence with futex.
+         * Watchers are homes of observers currently idle on frames of this location, writers to this location ring
+         * their doorbells. With no watcher, writers only read the watcher count.
+         */
+        class notice_block
+        {
+        public:
+            explicit notice_block(const std::string &path)
+            {
+                address_ = os::load_mmap_buffer(path, NOTICE_BLOCK_SIZE, true, true);
+            }
+
+            ~notice_block()
+            {
+                os::release_mmap_buffer(address_, NOTICE_BLOCK_SIZE, true);
+            }
+
+            void ring()
+            {
+                words()->notice_time.store(time::now_in_nano(), std::memory_order_relaxed);
+                words()->sequence.fetch_add(1);
+                if (words()->sleepers.load() > 0)
+                {
+                    os::futex_wake(reinterpret_cast<volatile uint32_t *>(&words()->sequence));
+                }
+            }
+
+            uint32_t get_sequence()
+            {
+                return words()->sequence.load();
+            }
+
+            int64_t get_notice_time()
+            {
+                return words()->notice_time.load(std::memory_order_relaxed);
+            }
+
+            /** wait until sequence moves away from given one, or timeout */
+            void wait(uint32_t sequence, int timeout_ms)
+            {
+                words()->sleepers.fetch_add(1);
+                os::futex_wait(reinterpret_cast<volatile uint32_t *>(&words()->sequence), sequence, timeout_ms);
+                words()->sleepers.fetch_sub(1);
+            }
+
+            bool has_watchers()
+            {
+                return words()->watcher_count.load(std::memory_order_relaxed) > 0;
+            }
+
+            template<typename Visitor>
+            void for_each_watcher(Visitor visitor)
+            {
+                for (auto &slot : words()->watchers)
+                {
+                    uint32_t uid = slot.load(std::memory_order_relaxed);
+                    if (uid != 0)
+                    {
+                        visitor(uid);
+                    }
+                }
+            }
+
+            /**
+             * add observer home to watchers, a slot left by an earlier run of the same home is taken over as is
+             * @return false if no slot is free
+             */
+            bool watch(uint32_t home_uid)
+            {
+                for (auto &slot : words()->watchers)
+                {
+                    if (slot.load() == home_uid)
+                    {
+                        return true;
+                    }
+                }
+                for (auto &slot : words()->watchers)
+                {
+                    uint32_t expected = 0;
+                    if (slot.compare_exchange_strong(expected, home_uid))
+                    {
+                        words()->watcher_count.fetch_add(1);
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void unwatch(uint32_t home_uid)
+            {
+                for (auto &slot : words()->watchers)
+                {
+                    uint32_t expected = home_uid;
+                    if (slot.compare_exchange_strong(expected, 0))
+                    {
+                        words()->watcher_count.fetch_sub(1);
+                        return;
+                    }
+                }
+            }
+
+        private:
+            struct notice_words
+            {
+                /** doorbell, written by writers of other locations */
+                std::atomic<uint32_t> sequence;
+                std::atomic<uint32_t> sleepers;
+                std::atomic<int64_t> notice_time;
+                /** watchers, written by observers reading this location, read by its writers */
+                alignas(64) std::atomic<uint32_t> watcher_count;
+                std::atomic<uint32_t> watchers[NOTICE_WATCHER_SLOTS];
+            };
+
+            static_assert(sizeof(notice_words) <= NOTICE_BLOCK_SIZE, "notice words exceed notice block");
+
+            uintptr_t address_;
+
+            notice_words *words()
+            {
+                return reinterpret_cast<notice_words *>(address_);
+            }
+        };
+
+        /**
+         * Notice blocks mapped by a process, keyed by location uid. Blocks are mapped on first use and kept until the
+         * board goes, lookups take no lock so that writer threads can ring concurrently.
+         */
+        class notice_board
+        {
+        public:
+            explicit notice_board(const data::location_ptr &master_location) :
+                    dir_(master_location->locator->layout_dir(master_location, layout::JOURNAL)), slots_()
+            {}
+
+            /** @return block of location, nullptr if it can not be mapped */
+            notice_block *get(uint32_t uid)
+            {
+                uint32_t index = find(uid);
+                if (index < NOTICE_BOARD_CAPACITY)
+                {
+                    auto block = slots_[index].block.load(std::memory_order_acquire);
+                    if (block != nullptr)
+                    {
+                        return block;
+                    }
+                }
+                return map(uid);
+            }
+
+            /** ring doorbells of observers idle on frames of location, costs a fence and a read if there are none */
+            void ring_watchers(uint32_t uid)
+            {
+                // pairs with the seq_cst watcher registration, either the watcher sees the frame or we see the watcher
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto block = get(uid);
+                if (block == nullptr or not block->has_watchers())
+                {
+                    return;
+                }
+                block->for_each_watcher([this](uint32_t watcher_uid)
+                                        {
+                                            auto doorbell = get(watcher_uid);
+                                            if (doorbell != nullptr)
+                                            {
+                                                doorbell->ring();
+                                            }
+                                        });
+            }
+
+        private:
+            struct slot
+            {
+                std::atomic<uint32_t> uid;
+                std::atomic<notice_block *> block;
+            };
+
+            const std::string dir_;
+            std::mutex mutex_;
+            std::vector<std::unique_ptr<notice_block>> blocks_;
+            slot slots_[NOTICE_BOARD_CAPACITY];
+
+            /** @return slot holding uid, or the free slot it would take, NOTICE_BOARD_CAPACITY if board is full */
+            uint32_t find(uint32_t uid)
+            {
+                for (uint32_t probe = 0; probe < NOTICE_BOARD_CAPACITY; probe++)
+                {
+                    uint32_t index = (uid + probe) % NOTICE_BOARD_CAPACITY;
+                    if (slots_[index].block.load(std::memory_order_acquire) == nullptr or
+                        slots_[index].uid.load(std::memory_order_relaxed) == uid)
+                    {
+                        return index;
+                    }
+                }
+                return NOTICE_BOARD_CAPACITY;
+            }
+
+            notice_block *map(uint32_t uid)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                uint32_t index = find(uid);
+                if (index == NOTICE_BOARD_CAPACITY)
+                {
+                    SPDLOG_ERROR("notice board full, can not map notice block of [{:08x}]", uid);
+                    return nullptr;
+                }
+                auto block = slots_[index].block.load(std::memory_order_relaxed);
+                if (block != nullptr)
+                {
+                    return block;
+                }
+                try
+                {
+                    blocks_.push_back(std::make_unique<notice_block>(fmt::format("{}/{:08x}.notice", dir_, uid)));
+                }
+                catch (const journal_error &e)
+                {
+                    SPDLOG_ERROR("can not map notice block of [{:08x}]: {}", uid, e.what());
+                    return nullptr;
+                }
+                block = blocks_.back().get();
+                slots_[index].uid.store(uid, std::memory_order_relaxed);
+                slots_[index].block.store(block, std::memory_order_release);
+                return block;
+            }
+        };
+#endif // __linux__
+
         class nanomsg_publisher : public publisher
         {
         public:
@@ -66,16 +311,40 @@ namespace kungfu
                 auto location = std::make_shared<data::location>(data::mode::LIVE, data::category::SYSTEM, "master", "master",
                                                                  io.get_home()->locator);
                 init_socket(socket_, location, io.get_url_factory());
+#ifdef __linux__
+                board_ = std::make_unique<notice_board>(location);
+                master_uid_ = location->uid;
+#endif // __linux__
             }
 
             int notify() override
             {
+#ifdef __linux__
+                board_->ring_watchers(master_uid_);
+                return 0;
+#else
                 return low_latency_ ? 0 : publish("{}");
+#endif // __linux__
+            }
+
+            int notify_location(uint32_t location_uid) override
+            {
+#ifdef __linux__
+                board_->ring_watchers(location_uid);
+                return 0;
+#else
+                return notify();
+#endif // __linux__
             }
 
             int publish(const std::string &json_message) override
             {
-                return socket_.send(json_message);
+                int result = socket_.send(json_message);
+#ifdef __linux__
+                // every observer watches master while idle, json notices travel through master sockets
+                board_->ring_watchers(master_uid_);
+#endif // __linux__
+                return result;
             }
 
         protected:
@@ -84,6 +353,10 @@ namespace kungfu
         private:
             const bool low_latency_;
             socket socket_;
+#ifdef __linux__
+            std::unique_ptr<notice_board> board_;
+            uint32_t master_uid_ = 0;
+#endif // __linux__
         };
 
         class nanomsg_publisher_master : public nanomsg_publisher
@@ -117,17 +390,30 @@ namespace kungfu
         {
         public:
             nanomsg_observer(bool low_latency, protocol p) : low_latency_(low_latency), socket_(p), recv_flags_(low_latency ? NN_DONTWAIT : 0)
-            {}
+            {
+                if (low_latency)
+                {
+                    strategy_.spin_us = -1;
+                }
+            }
 
             void init(const io_device &io)
             {
                 auto location = std::make_shared<data::location>(data::mode::LIVE, data::category::SYSTEM, "master", "master",
                                                                  io.get_home()->locator);
                 init_socket(socket_, location, io.get_url_factory());
+#ifdef __linux__
+                io_ = &io;
+                board_ = std::make_unique<notice_board>(location);
+                master_uid_ = location->uid;
+                home_uid_ = io.get_home()->uid;
+                doorbell_ = board_->get(home_uid_);
+#else
                 if (not low_latency_)
                 {
                     socket_.setsockopt_int(NN_SOL_SOCKET, NN_RCVTIMEO, DEFAULT_NOTICE_TIMEOUT);
                 }
+#endif // __linux__
             }
 
             virtual ~nanomsg_observer()
@@ -137,7 +423,30 @@ namespace kungfu
 
             bool wait() override
             {
+#ifdef __linux__
+                if (socket_.recv(NN_DONTWAIT) > 0)
+                {
+                    return true;
+                }
+                if (strategy_.spin_us < 0 or doorbell_ == nullptr)
+                {
+                    return false;
+                }
+                uint32_t sequence = doorbell_->get_sequence();
+                watch();
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                // frames committed and notices sent before watch took effect rang no doorbell, look once more
+                bool received = socket_.recv(NN_DONTWAIT) > 0;
+                if (not received and not frames_available())
+                {
+                    idle(sequence);
+                    received = socket_.recv(NN_DONTWAIT) > 0;
+                }
+                unwatch();
+                return received;
+#else
                 return socket_.recv(recv_flags_) > 0;
+#endif // __linux__
             }
 
             const std::string &get_notice() override
@@ -153,6 +462,105 @@ namespace kungfu
             const bool low_latency_;
             socket socket_;
             int recv_flags_;
+#ifdef __linux__
+            const io_device *io_ = nullptr;
+            std::unique_ptr<notice_board> board_;
+            uint32_t master_uid_ = 0;
+            uint32_t home_uid_ = 0;
+            notice_block *doorbell_ = nullptr;
+            std::vector<uint32_t> watched_uids_;
+            std::vector<notice_block *> watched_;
+
+            /** register as watcher of master and of every location the subscribe reader reads */
+            void watch()
+            {
+                auto &reader = io_->get_subscribe_reader();
+                if (reader)
+                {
+                    reader->get_location_uids(watched_uids_);
+                } else
+                {
+                    watched_uids_.clear();
+                }
+                if (std::find(watched_uids_.begin(), watched_uids_.end(), master_uid_) == watched_uids_.end())
+                {
+                    watched_uids_.push_back(master_uid_);
+                }
+                for (uint32_t uid : watched_uids_)
+                {
+                    auto block = board_->get(uid);
+                    if (block == nullptr)
+                    {
+                        continue;
+                    }
+                    if (block->watch(home_uid_))
+                    {
+                        watched_.push_back(block);
+                    } else
+                    {
+                        SPDLOG_WARN("no watcher slot left at [{:08x}], wake up on timeout", uid);
+                    }
+                }
+            }
+
+            void unwatch()
+            {
+                for (auto block : watched_)
+                {
+                    block->unwatch(home_uid_);
+                }
+                watched_.clear();
+            }
+
+            bool frames_available()
+            {
+                auto &reader = io_->get_subscribe_reader();
+                return reader and reader->data_available();
+            }
+
+            /** spin, then yield, then block per strategy, until doorbell moves away from sequence or timeout */
+            void idle(uint32_t sequence)
+            {
+                stats_.idle_count++;
+                int64_t start = time::now_in_nano();
+                int64_t now = start;
+                uint32_t current = sequence;
+                uint64_t *wakeup_count = &stats_.block_wakeup_count;
+                while (current == sequence and now - start < strategy_.spin_us * time_unit::NANOSECONDS_PER_MICROSECOND)
+                {
+                    os::cpu_relax();
+                    current = doorbell_->get_sequence();
+                    now = time::now_in_nano();
+                    wakeup_count = &stats_.spin_wakeup_count;
+                }
+                while (current == sequence and now - start < strategy_.yield_us * time_unit::NANOSECONDS_PER_MICROSECOND)
+                {
+                    std::this_thread::yield();
+                    current = doorbell_->get_sequence();
+                    now = time::now_in_nano();
+                    wakeup_count = &stats_.yield_wakeup_count;
+                }
+                stats_.spin_time += now - start;
+                if (current == sequence)
+                {
+                    doorbell_->wait(sequence, strategy_.block_ms);
+                    current = doorbell_->get_sequence();
+                    int64_t woken = time::now_in_nano();
+                    stats_.block_time += woken - now;
+                    now = woken;
+                    wakeup_count = &stats_.block_wakeup_count;
+                }
+                if (current == sequence)
+                {
+                    stats_.timeout_count++;
+                    return;
+                }
+                (*wakeup_count)++;
+                int64_t latency = std::max<int64_t>(now - doorbell_->get_notice_time(), 0);
+                stats_.wakeup_latency_total += latency;
+                stats_.wakeup_latency_max = std::max(stats_.wakeup_latency_max, latency);
+            }
+#endif // __linux__
         };
 
         class nanomsg_observer_master : public nanomsg_observer
@@ -191,12 +599,13 @@ namespace kungfu
 
         reader_ptr io_device::open_reader_to_subscribe()
         {
-            return std::make_shared<reader>(lazy_);
+            subscribe_reader_ = std::make_shared<reader>(lazy_, home_->mode != data::mode::LIVE);
+            return subscribe_reader_;
         }
 
         reader_ptr io_device::open_reader(const data::location_ptr &location, uint32_t dest_id)
         {
-            auto r = std::make_shared<reader>(lazy_);
+            auto r = std::make_shared<reader>(lazy_, home_->mode != data::mode::LIVE);
             r->join(location, dest_id, 0);
             return r;
         }
@@ -13,12 +13,16 @@
  *  limitations under the License.
  *****************************************************************************/
 
+#include <thread>
+#include <deque>
+#include <functional>
 #include <spdlog/spdlog.h>
 
 #include <kungfu/yijinjing/time.h>
 #include <kungfu/yijinjing/journal/journal.h>
 #include <kungfu/yijinjing/journal/page.h>
 #include <kungfu/yijinjing/util/util.h>
+#include <kungfu/yijinjing/util/os.h>
 #include <kungfu/yijinjing/msg.h>
 
 namespace kungfu
@@ -27,13 +31,134 @@ namespace kungfu
     {
         namespace journal
         {
+            constexpr size_t PREFAULT_STRIDE = 4096;
 
-            journal::~journal()
+            /**
+             * Helper thread which runs tasks in order of submission.
+             * Workers are never destroyed, pending tasks are dropped when process exits.
+             */
+            class page_worker
             {
-                if (current_page_.get() != nullptr)
+            public:
+                /** shared by all page providers in process, writers wait on it at rollover so it takes nothing else */
+                static page_worker &prepare_worker()
+                {
+                    static page_worker *worker = new page_worker();
+                    return *worker;
+                }
+
+                /** shared by all readers in process which read ahead */
+                static page_worker &readahead_worker()
+                {
+                    static page_worker *worker = new page_worker();
+                    return *worker;
+                }
+
+                void post(std::function<void()> task)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        tasks_.push_back(std::move(task));
+                    }
+                    cv_.notify_one();
+                }
+
+            private:
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::deque<std::function<void()>> tasks_;
+
+                page_worker()
+                {
+                    std::thread(&page_worker::run, this).detach();
+                }
+
+                void run()
+                {
+                    // do not inherit cpu pinning and SCHED_FIFO of the loop thread which may have spawned us
+                    os::reset_thread_policy();
+                    while (true)
+                    {
+                        std::function<void()> task;
+                        {
+                            std::unique_lock<std::mutex> lock(mutex_);
+                            cv_.wait(lock, [this]
+                            { return not tasks_.empty(); });
+                            task = std::move(tasks_.front());
+                            tasks_.pop_front();
+                        }
+                        task();
+                    }
+                }
+            };
+
+            page_ptr page_provider::get_page(int page_id)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                prepared_cv_.wait(lock, [&]
+                { return preparing_id_ != page_id; });
+                if (prepared_.get() != nullptr and prepared_->get_page_id() == page_id)
+                {
+                    return std::move(prepared_);
+                }
+                lock.unlock();
+                return page::load(location_, dest_id_, page_id, true, lazy_);
+            }
+
+            void page_provider::prepare(int page_id)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (preparing_id_ == page_id or (prepared_.get() != nullptr and prepared_->get_page_id() == page_id))
+                    {
+                        return;
+                    }
+                    preparing_id_ = page_id;
+                }
+                // locator may be implemented in python, resolve path here rather than on helper thread
+                auto path = page::get_page_path(location_, dest_id_, page_id);
+                auto frame_index_path = frame_index::get_index_path(location_, dest_id_, page_id);
+                auto huge_page = page::use_huge_page(location_);
+                auto page_size = location_->locator->page_size(location_, dest_id_);
+                auto self = shared_from_this();
+                page_worker::prepare_worker().post([self, page_id, path, frame_index_path, huge_page, page_size]()
+                                                   { self->do_prepare(page_id, path, frame_index_path, huge_page, page_size); });
+            }
+
+            void page_provider::do_prepare(int page_id, const std::string &path, const std::string &frame_index_path, bool huge_page,
+                                           uint32_t page_size)
+            {
+                page_ptr page;
+                try
+                {
+                    page = page::load(location_, dest_id_, page_id, path, frame_index_path, true, lazy_, huge_page, page_size);
+                    // read in and map every memory page so that writer does not take a major fault on it, reading leaves
+                    // them clean, only pages the writer actually fills are written back
+                    os::advise_mmap_buffer(page->address(), page->get_page_size(), os::mmap_advice::WILLNEED);
+                    for (uintptr_t address = page->address(); address < page->address() + page->get_page_size(); address += PREFAULT_STRIDE)
+                    {
+                        *reinterpret_cast<volatile const char *>(address);
+                    }
+                    SPDLOG_TRACE("prepared page {}/{:08x}.{}.journal", location_->uname, dest_id_, page_id);
+                }
+                catch (const std::exception &e)
+                {
+                    SPDLOG_ERROR("can not prepare page {}/{:08x}.{}.journal: {}", location_->uname, dest_id_, page_id, e.what());
+                }
                 {
-                    current_page_.reset();
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (preparing_id_ == page_id)
+                    {
+                        prepared_ = page;
+                        preparing_id_ = 0;
+                    }
                 }
+                prepared_cv_.notify_all();
+            }
+
+            journal::~journal()
+            {
+                page_reclaimer::instance().retire(std::move(current_page_));
             }
 
             void journal::next()
@@ -51,7 +176,7 @@ namespace kungfu
 
             void journal::seek_to_time(int64_t nanotime)
             {
-                int page_id = page::find_page_id(location_, dest_id_, nanotime);
+                int page_id = page::find_page_id(location_, dest_id_, nanotime, is_writing_);
                 load_page(page_id);
                 SPDLOG_TRACE("{} in page [{}] [{} - {}]",
                              nanotime > 0 ? time::strftime(nanotime) : "beginning", page_id,
@@ -60,22 +185,147 @@ namespace kungfu
                 {
                     load_next_page();
                 }
+                if (nanotime > current_page_->begin_time())
+                {
+                    auto entries = frame_index::load(location_, dest_id_, current_page_->get_page_id());
+                    auto entry = frame_index::find(entries, nanotime);
+                    if (entry != nullptr and entry->position < current_page_->get_page_size() and
+                        current_page_->address() + entry->position > frame_->address())
+                    {
+                        auto header = reinterpret_cast<frame_header *>(current_page_->address() + entry->position);
+                        if (header->length > 0 and header->gen_time == entry->gen_time)
+                        {
+                            frame_->set_address(current_page_->address() + entry->position);
+                            page_frame_nb_ = entry->frame_nb;
+                        }
+                    }
+                }
                 while (frame_->has_data() && frame_->gen_time() <= nanotime)
                 {
                     next();
                 }
             }
 
+            void journal::seek_to_end(std::vector<frame_index_entry> &frame_index)
+            {
+                auto page_entries = page_index::load(location_, dest_id_, is_writing_);
+                load_page(page_entries.empty() ? 1 : page_entries.back().page_id + 1);
+                int page_id = current_page_->get_page_id();
+                frame_index = frame_index::load(location_, dest_id_, page_id);
+                auto last_frame_address = current_page_->last_frame_address();
+                while (not frame_index.empty())
+                {
+                    auto &entry = frame_index.back();
+                    auto address = current_page_->address() + entry.position;
+                    auto header = reinterpret_cast<frame_header *>(address);
+                    if (address <= last_frame_address and header->length > 0 and header->gen_time == entry.gen_time)
+                    {
+                        frame_->set_address(address);
+                        page_frame_nb_ = entry.frame_nb;
+                        break;
+                    }
+                    frame_index.pop_back();
+                }
+                if (frame_index.empty() and last_frame_address > current_page_->first_frame_address())
+                {
+                    SPDLOG_WARN("no frame index for {}/{:08x}.{}.journal, scan page to resume", location_->uname, dest_id_, page_id);
+                }
+                while (frame_->has_data())
+                {
+                    if (current_page_->get_page_id() != page_id)
+                    {
+                        page_id = current_page_->get_page_id();
+                        frame_index.clear();
+                    }
+                    if (page_frame_nb_ % FRAME_INDEX_INTERVAL == 0 and
+                        (frame_index.empty() or frame_index.back().frame_nb < static_cast<uint32_t>(page_frame_nb_)))
+                    {
+                        frame_index_entry entry = {};
+                        entry.frame_nb = page_frame_nb_;
+                        entry.position = frame_->address() - current_page_->address();
+                        entry.gen_time = frame_->gen_time();
+                        frame_index.push_back(entry);
+                    }
+                    next();
+                }
+                if (current_page_->get_page_id() != page_id)
+                {
+                    frame_index.clear();
+                }
+                if (frame_->address() <= current_page_->last_frame_address() and
+                    reinterpret_cast<frame_header *>(current_page_->last_frame_address())->length > 0)
+                {
+                    SPDLOG_ERROR("{}/{:08x}.{}.journal ends at {} before last frame position {}", location_->uname, dest_id_,
+                                 current_page_->get_page_id(), frame_->address() - current_page_->address(),
+                                 current_page_->last_frame_address() - current_page_->address());
+                }
+            }
+
             void journal::load_page(int page_id)
             {
                 if (current_page_.get() == nullptr or current_page_->get_page_id() != page_id)
                 {
-                    current_page_ = page::load(location_, dest_id_, page_id, is_writing_, lazy_);
+                    if (readahead_ and current_page_.get() != nullptr)
+                    {
+                        drop_consumed(std::move(current_page_));
+                    }
+                    page_reclaimer::instance().retire(std::move(current_page_));
+                    current_page_ = page_provider_ ? page_provider_->get_page(page_id) :
+                                    page_cache::instance().load(location_, dest_id_, page_id, lazy_);
                     frame_->set_address(current_page_->first_frame_address());
                     page_frame_nb_ = 0;
+                    if (page_provider_)
+                    {
+                        page_provider_->prepare(page_id + 1);
+                    }
+                    if (readahead_)
+                    {
+                        read_ahead();
+                    }
                 }
             }
 
+            void journal::read_ahead()
+            {
+                auto &page = current_page_;
+                os::advise_mmap_buffer(page->address(), page->get_page_size(), os::mmap_advice::SEQUENTIAL);
+                // resolve path here, locator may need python GIL which helper thread does not hold
+                auto next_path = page::get_page_path(location_, dest_id_, page->get_page_id() + 1);
+                // a pending task must not keep the page alive, or drop_consumed would take it as still in use
+                std::weak_ptr<class page> weak_page = page;
+                page_worker::readahead_worker().post([weak_page, next_path]()
+                                                     {
+                                                         auto page = weak_page.lock();
+                                                         if (page.get() == nullptr)
+                                                         {
+                                                             return;
+                                                         }
+                                                         os::advise_mmap_buffer(page->address(), page->get_page_size(), os::mmap_advice::WILLNEED);
+                                                         // fault in ahead of reader, reader mapping is read only so only read
+                                                         for (uintptr_t address = page->address(); address < page->address() + page->get_page_size();
+                                                              address += PREFAULT_STRIDE)
+                                                         {
+                                                             *reinterpret_cast<volatile const char *>(address);
+                                                         }
+                                                         os::prefetch_file(next_path);
+                                                     });
+            }
+
+            void journal::drop_consumed(page_ptr &&page)
+            {
+                // queued behind readahead tasks of the page, so that the worker is done with it when the count is taken
+                page_worker::readahead_worker().post([page = std::move(page)]() mutable
+                                                     {
+                                                         // held by this task and page_cache only
+                                                         if (page.use_count() <= 2)
+                                                         {
+                                                             os::advise_mmap_buffer(page->address(), page->get_page_size(),
+                                                                                    os::mmap_advice::DONTNEED);
+                                                         }
+                                                         page_reclaimer::instance().retire(std::move(page));
+                                                     });
+            }
+
             void journal::load_next_page()
             {
                 load_page(current_page_->get_page_id() + 1);
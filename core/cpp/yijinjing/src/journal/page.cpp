@@ -15,10 +15,21 @@
 
 #include <utility>
 #include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cstddef>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 #include <fmt/format.h>
 #include <spdlog/spdlog.h>
 
+#include <kungfu/yijinjing/msg.h>
+#include <kungfu/yijinjing/time.h>
 #include <kungfu/yijinjing/util/os.h>
+#include <kungfu/yijinjing/util/util.h>
 #include <kungfu/yijinjing/journal/page.h>
 
 namespace kungfu
@@ -27,14 +38,21 @@ namespace kungfu
     {
         namespace journal
         {
-            page::page(const data::location_ptr &location, uint32_t dest_id, const int id, const size_t size, const bool lazy, uintptr_t address) :
-                    location_(location), dest_id_(dest_id), page_id_(id), size_(size), lazy_(lazy), header_(reinterpret_cast<page_header *>(address))
+            page::page(const data::location_ptr &location, uint32_t dest_id, const int id, std::string path, const size_t size,
+                       const bool lazy, uintptr_t address) :
+                    location_(location), dest_id_(dest_id), page_id_(id), path_(std::move(path)), size_(size), lazy_(lazy),
+                    header_(reinterpret_cast<page_header *>(address)), locked_(false), frame_index_address_(0),
+                    frame_index_capacity_(0)
             {
                 assert(address > 0);
             }
 
             page::~page()
             {
+                if (frame_index_address_ != 0)
+                {
+                    os::release_mmap_buffer(frame_index_address_, frame_index_capacity_ * sizeof(frame_index_entry), true);
+                }
                 if (os::release_mmap_buffer(address(), size_, lazy_))
                 {
                     SPDLOG_TRACE("released page {}/{:08x}.{}.journal", location_->uname, dest_id_, page_id_);
@@ -49,11 +67,75 @@ namespace kungfu
                 const_cast<page_header *>(header_)->last_frame_position = position;
             }
 
+            void page::index_frame(const frame_index_entry &entry)
+            {
+                uint32_t slot = entry.frame_nb / FRAME_INDEX_INTERVAL;
+                if (frame_index_address_ == 0 or slot >= frame_index_capacity_)
+                {
+                    return;
+                }
+                auto target = reinterpret_cast<frame_index_entry *>(frame_index_address_) + slot;
+                target->frame_nb = entry.frame_nb;
+                target->position = entry.position;
+                // readers stop at the first slot without gen_time, store it last
+                store_release(reinterpret_cast<volatile int64_t *>(frame_index_address_ + slot * sizeof(frame_index_entry) +
+                                                                   offsetof(frame_index_entry, gen_time)), entry.gen_time);
+            }
+
+            void page::restore_frame_index(const std::vector<frame_index_entry> &entries)
+            {
+                if (frame_index_address_ == 0)
+                {
+                    return;
+                }
+                auto slots = reinterpret_cast<frame_index_entry *>(frame_index_address_);
+                for (uint32_t slot = 0; slot < frame_index_capacity_; slot++)
+                {
+                    if (slots[slot].gen_time != 0)
+                    {
+                        slots[slot] = {};
+                    }
+                }
+                for (const auto &entry : entries)
+                {
+                    index_frame(entry);
+                }
+            }
+
             page_ptr page::load(const data::location_ptr &location, uint32_t dest_id, int page_id, bool is_writing, bool lazy)
             {
-                uint32_t page_size = find_page_size(location, dest_id);
-                std::string path = get_page_path(location, dest_id, page_id);
-                uintptr_t address = os::load_mmap_buffer(path, page_size, is_writing, lazy);
+                return load(location, dest_id, page_id, get_page_path(location, dest_id, page_id),
+                            is_writing ? frame_index::get_index_path(location, dest_id, page_id) : "", is_writing, lazy,
+                            use_huge_page(location), location->locator->page_size(location, dest_id));
+            }
+
+            /** @return page size recorded in header of existing page, 0 if page not yet initialized */
+            static uint32_t read_page_size(const std::string &path)
+            {
+                std::ifstream page_file(path, std::ios::binary);
+                page_header header = {};
+                if (page_file.read(reinterpret_cast<char *>(&header), sizeof(page_header)) and header.last_frame_position > 0)
+                {
+                    return header.page_size;
+                }
+                return 0;
+            }
+
+            page_ptr page::load(const data::location_ptr &location, uint32_t dest_id, int page_id, const std::string &path,
+                                const std::string &frame_index_path, bool is_writing, bool lazy, bool huge_page,
+                                uint32_t new_page_size)
+            {
+                uint32_t page_size = read_page_size(path);
+                if (page_size == 0)
+                {
+                    page_size = new_page_size;
+                }
+                if (page_size < sizeof(page_header) + 2 * sizeof(frame_header) or page_size % KB != 0)
+                {
+                    throw journal_error(fmt::format("invalid page size {} for page {}", page_size, path));
+                }
+                bool locked = os::is_page_locking();
+                uintptr_t address = os::load_mmap_buffer(path, page_size, is_writing, lazy, huge_page);
                 if (address < 0)
                 {
                     throw journal_error("unable to load page for " + path);
@@ -70,10 +152,19 @@ namespace kungfu
                     header->last_frame_position = header->page_header_length;
                 }
 
-                if (header->version != __JOURNAL_VERSION__)
+                if (is_writing and header->version < __JOURNAL_VERSION__ and
+                    header->last_frame_position == header->page_header_length and
+                    reinterpret_cast<frame_header *>(address + header->page_header_length)->length == 0)
                 {
-                    throw journal_error(fmt::format("version mismatch for page {}, required {}, found {}",
-                                                    path, __JOURNAL_VERSION__, header->version));
+                    // no frame written yet, e.g. prepared by an older version, take it over with current frame layout
+                    header->version = __JOURNAL_VERSION__;
+                    header->frame_header_length = sizeof(frame_header);
+                }
+
+                if (header->version < __JOURNAL_VERSION_MIN__ or header->version > __JOURNAL_VERSION__)
+                {
+                    throw journal_error(fmt::format("version mismatch for page {}, required {} to {}, found {}",
+                                                    path, __JOURNAL_VERSION_MIN__, __JOURNAL_VERSION__, header->version));
                 }
                 if (header->page_header_length != sizeof(page_header))
                 {
@@ -85,36 +176,513 @@ namespace kungfu
                     throw journal_error(fmt::format("page size mismatch, required {}, found {}", page_size, header->page_size));
                 }
 
-                return std::shared_ptr<page>(new page(location, dest_id, page_id, page_size, lazy, address));
+                auto result = std::shared_ptr<page>(new page(location, dest_id, page_id, path, page_size, lazy, address));
+                result->locked_ = locked;
+                if (is_writing and not frame_index_path.empty())
+                {
+                    uint32_t capacity = frame_index::capacity(page_size);
+                    try
+                    {
+                        result->frame_index_address_ = os::load_mmap_buffer(frame_index_path, capacity * sizeof(frame_index_entry), true, true);
+                        result->frame_index_capacity_ = capacity;
+                    }
+                    catch (const journal_error &e)
+                    {
+                        // seeking into this page falls back to walking frames
+                        SPDLOG_ERROR("can not map frame index {}: {}", frame_index_path, e.what());
+                    }
+                }
+                return result;
             }
 
-            std::string page::get_page_path(const data::location_ptr &location, uint32_t dest_id, int id)
+            page_reclaimer &page_reclaimer::instance()
+            {
+                // never destroyed, pages still queued when process exits are left to the os
+                static page_reclaimer *reclaimer = new page_reclaimer();
+                return *reclaimer;
+            }
+
+            page_reclaimer::page_reclaimer() :
+                    retired_count_(0), reclaimed_count_(0), overflow_count_(0), max_queue_depth_(0), reclaim_time_(0)
+            {
+                std::thread(&page_reclaimer::run, this).detach();
+            }
+
+            void page_reclaimer::retire(page_ptr &&page)
+            {
+                if (page.get() == nullptr)
+                {
+                    return;
+                }
+                retired_count_++;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (queue_.size() < PAGE_RECLAIM_QUEUE_SIZE)
+                    {
+                        queue_.push_back(std::move(page));
+                        if (queue_.size() > max_queue_depth_)
+                        {
+                            max_queue_depth_ = queue_.size();
+                        }
+                    }
+                }
+                if (page.get() == nullptr)
+                {
+                    cv_.notify_one();
+                } else
+                {
+                    overflow_count_++;
+                    SPDLOG_WARN("page reclaim queue full, release {}/{:08x}.{}.journal in place",
+                                page->get_location()->uname, page->get_dest_id(), page->get_page_id());
+                    page.reset();
+                }
+            }
+
+            void page_reclaimer::run()
+            {
+                // do not inherit cpu pinning and SCHED_FIFO of the loop thread which may have spawned us
+                os::reset_thread_policy();
+                while (true)
+                {
+                    page_ptr page;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [this]
+                        { return not queue_.empty(); });
+                        page = std::move(queue_.front());
+                        queue_.pop_front();
+                    }
+                    int64_t start_time = time::now_in_nano();
+                    page.reset();
+                    reclaim_time_ += time::now_in_nano() - start_time;
+                    reclaimed_count_++;
+                }
+            }
+
+            page_persister &page_persister::instance()
+            {
+                // never destroyed, writers flush it before they go
+                static page_persister *persister = new page_persister();
+                return *persister;
+            }
+
+            page_persister::page_persister() : busy_(false), persisted_count_(0), persist_time_(0)
+            {
+                std::thread(&page_persister::run, this).detach();
+            }
+
+            void page_persister::persist(page_ptr page, std::string durable_path, std::string retired_path)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    queue_.push_back({std::move(page), std::move(durable_path), std::move(retired_path), "", {}});
+                }
+                cv_.notify_one();
+            }
+
+            void page_persister::append_index(std::string index_path, const page_index_entry &entry)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    queue_.push_back({nullptr, "", "", std::move(index_path), entry});
+                }
+                cv_.notify_one();
+            }
+
+            void page_persister::flush()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                flushed_cv_.wait(lock, [this]
+                { return queue_.empty() and not busy_; });
+            }
+
+            void page_persister::copy(const page_ptr &page, const std::string &durable_path)
+            {
+                auto last_frame = reinterpret_cast<frame_header *>(page->last_frame_address());
+                size_t length = std::min<size_t>(page->last_frame_address() + last_frame->length + sizeof(frame_header) - page->address(),
+                                                 page->get_page_size());
+                auto persisting_path = durable_path + ".persisting";
+                {
+                    std::ofstream target(persisting_path, std::ios::binary | std::ios::trunc);
+                    target.write(reinterpret_cast<const char *>(page->address()), length);
+                    // leave the rest a hole, readers map the whole page
+                    target.seekp(page->get_page_size() - 1);
+                    target.put(0);
+                    if (not target)
+                    {
+                        throw journal_error(fmt::format("can not persist page {} to {}", page->get_path(), durable_path));
+                    }
+                }
+                if (std::rename(persisting_path.c_str(), durable_path.c_str()) != 0)
+                {
+                    throw journal_error(fmt::format("can not persist page {} to {}", page->get_path(), durable_path));
+                }
+            }
+
+            void page_persister::run()
+            {
+                // do not inherit cpu pinning and SCHED_FIFO of the loop thread which may have spawned us
+                os::reset_thread_policy();
+                while (true)
+                {
+                    task t;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [this]
+                        { return not queue_.empty(); });
+                        t = std::move(queue_.front());
+                        queue_.pop_front();
+                        busy_ = true;
+                    }
+                    if (not t.index_path.empty())
+                    {
+                        page_index::append(t.index_path, t.index_entry);
+                    }
+                    if (t.page.get() != nullptr)
+                    {
+                        int64_t start_time = time::now_in_nano();
+                        try
+                        {
+                            copy(t.page, t.durable_path);
+                            if (not t.retired_path.empty())
+                            {
+                                std::remove(t.retired_path.c_str());
+                            }
+                            SPDLOG_TRACE("persisted page {} to {}", t.page->get_path(), t.durable_path);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            SPDLOG_ERROR("{}", e.what());
+                        }
+                        t.page.reset();
+                        persist_time_ += time::now_in_nano() - start_time;
+                        persisted_count_++;
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        busy_ = false;
+                    }
+                    flushed_cv_.notify_all();
+                }
+            }
+
+            page_cache &page_cache::instance()
+            {
+                // never destroyed, same as page_reclaimer which evicted pages are handed to
+                static page_cache *cache = new page_cache();
+                return *cache;
+            }
+
+            page_cache::page_cache() :
+                    budget_(PAGE_CACHE_BUDGET), mapped_bytes_(0), hit_count_(0), miss_count_(0), evicted_count_(0)
+            {}
+
+            page_ptr page_cache::load(const data::location_ptr &location, uint32_t dest_id, int page_id, bool lazy)
+            {
+                key k = {location->uid, dest_id, page_id};
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    auto it = entries_.find(k);
+                    if (it != entries_.end() and (lazy or not it->second.page->lazy_))
+                    {
+                        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+                        hit_count_++;
+                        return it->second.page;
+                    }
+                }
+                // map outside of lock, a concurrent miss on the same key maps twice and the later one wins
+                auto page = page::load(location, dest_id, page_id, false, lazy);
+                std::vector<page_ptr> evicted;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    miss_count_++;
+                    auto it = entries_.find(k);
+                    if (it != entries_.end())
+                    {
+                        mapped_bytes_ -= it->second.page->size_;
+                        evicted.push_back(std::move(it->second.page));
+                        lru_.erase(it->second.lru_position);
+                        entries_.erase(it);
+                    }
+                    lru_.push_front(k);
+                    entries_[k] = {page, lru_.begin()};
+                    mapped_bytes_ += page->size_;
+                    evict(evicted);
+                }
+                for (auto &p : evicted)
+                {
+                    page_reclaimer::instance().retire(std::move(p));
+                }
+                return page;
+            }
+
+            void page_cache::evict(std::vector<page_ptr> &evicted)
+            {
+                auto it = lru_.end();
+                while (it != lru_.begin())
+                {
+                    --it;
+                    auto entry = entries_.find(*it);
+                    auto &page = entry->second.page;
+                    if (page.use_count() > 1 or (not page->locked_ and mapped_bytes_ <= budget_))
+                    {
+                        continue;
+                    }
+                    mapped_bytes_ -= entry->second.page->size_;
+                    evicted.push_back(std::move(entry->second.page));
+                    entries_.erase(entry);
+                    it = lru_.erase(it);
+                    evicted_count_++;
+                }
+            }
+
+            void page_cache::set_budget(size_t budget)
+            {
+                std::vector<page_ptr> evicted;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    budget_ = budget;
+                    evict(evicted);
+                }
+                for (auto &p : evicted)
+                {
+                    page_reclaimer::instance().retire(std::move(p));
+                }
+            }
+
+            double page_cache::get_hit_rate() const
+            {
+                uint64_t hits = hit_count_;
+                uint64_t total = hits + miss_count_;
+                return total == 0 ? 0 : double(hits) / total;
+            }
+
+            size_t page_cache::get_page_count()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return entries_.size();
+            }
+
+            /** whether env holds a comma separated list of category names which includes category of location */
+            static bool env_has_category(const data::location_ptr &location, const std::string &env)
+            {
+                if (not location->locator->has_env(env))
+                {
+                    return false;
+                }
+                std::stringstream categories(location->locator->get_env(env));
+                std::string category;
+                while (std::getline(categories, category, ','))
+                {
+                    if (category == data::get_category_name(location->category))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool page::use_huge_page(const data::location_ptr &location)
+            {
+                return env_has_category(location, HUGE_PAGE_ENV);
+            }
+
+            bool page::use_shm(const data::location_ptr &location)
+            {
+#ifdef _WIN32
+                return false;
+#else
+                return env_has_category(location, SHM_JOURNAL_ENV);
+#endif
+            }
+
+            std::string page::get_durable_page_path(const data::location_ptr &location, uint32_t dest_id, int id)
             {
                 return location->locator->layout_file(location, data::layout::JOURNAL, fmt::format("{:08x}.{}", dest_id, id));
             }
 
-            int page::find_page_id(const data::location_ptr &location, uint32_t dest_id, int64_t time)
+            std::string page::get_shm_page_path(const data::location_ptr &location, uint32_t dest_id, int id)
+            {
+#ifndef _WIN32
+                mkdir(SHM_JOURNAL_DIR, 0755);
+#endif
+                // journal directory hash tells apart same location under different homes
+                auto dir_hash = util::hash_str_32(location->locator->layout_dir(location, data::layout::JOURNAL));
+                return fmt::format("{}/{:08x}.{:08x}.{}.journal", SHM_JOURNAL_DIR, dir_hash, dest_id, id);
+            }
+
+            static bool file_exists(const std::string &path)
+            {
+                return std::ifstream(path).good();
+            }
+
+            std::string page::get_page_path(const data::location_ptr &location, uint32_t dest_id, int id)
+            {
+                auto durable_path = get_durable_page_path(location, dest_id, id);
+                if (not use_shm(location))
+                {
+                    return durable_path;
+                }
+                auto shm_path = get_shm_page_path(location, dest_id, id);
+                if (file_exists(shm_path))
+                {
+                    return shm_path;
+                }
+                // persisted, or left by writer when memory resident copy is gone (e.g. reboot), writer goes on with it
+                // in place rather than copying it back, readers may have mapped it already
+                return file_exists(durable_path) ? durable_path : shm_path;
+            }
+
+            int page::find_page_id(const data::location_ptr &location, uint32_t dest_id, int64_t time, bool is_writing)
+            {
+                return page_index::find_page_id(page_index::load(location, dest_id, is_writing), time);
+            }
+
+            static bool page_exists(const data::location_ptr &location, uint32_t dest_id, int page_id)
+            {
+                return file_exists(page::get_page_path(location, dest_id, page_id));
+            }
+
+            /** writers prepare the next page ahead of time, such page exists but holds no frame yet */
+            static bool page_has_data(const data::location_ptr &location, uint32_t dest_id, int page_id)
+            {
+                std::ifstream page_file(page::get_page_path(location, dest_id, page_id), std::ios::binary);
+                page_header header = {};
+                frame_header first_frame = {};
+                if (not page_file.read(reinterpret_cast<char *>(&header), sizeof(page_header)))
+                {
+                    return false;
+                }
+                page_file.seekg(header.page_header_length);
+                return page_file.read(reinterpret_cast<char *>(&first_frame), sizeof(frame_header)) and first_frame.length > 0;
+            }
+
+            std::string page_index::get_index_path(const data::location_ptr &location, uint32_t dest_id)
+            {
+                return fmt::format("{}/{:08x}.index", location->locator->layout_dir(location, data::layout::JOURNAL), dest_id);
+            }
+
+            std::vector<page_index_entry> page_index::load(const data::location_ptr &location, uint32_t dest_id, bool is_writing)
+            {
+                std::vector<page_index_entry> entries;
+                std::ifstream index_file(get_index_path(location, dest_id), std::ios::binary);
+                page_index_entry entry = {};
+                while (index_file.read(reinterpret_cast<char *>(&entry), sizeof(page_index_entry)))
+                {
+                    entries.push_back(entry);
+                }
+                // the page right after the last closed one is still being written, anything beyond means index is stale
+                bool stale = entries.empty() ? not page_exists(location, dest_id, 1) || page_has_data(location, dest_id, 2) :
+                             page_has_data(location, dest_id, entries.back().page_id + 2);
+                if (stale)
+                {
+                    return rebuild(location, dest_id, is_writing);
+                }
+                return entries;
+            }
+
+            std::vector<page_index_entry> page_index::rebuild(const data::location_ptr &location, uint32_t dest_id, bool persist)
             {
                 std::vector<int> page_ids = location->locator->list_page_id(location, dest_id);
-                if (page_ids.empty())
+                std::sort(page_ids.begin(), page_ids.end());
+                std::vector<page_index_entry> entries;
+                for (int page_id : page_ids)
+                {
+                    auto page = page_cache::instance().load(location, dest_id, page_id, true);
+                    auto last_frame = reinterpret_cast<frame_header *>(page->last_frame_address());
+                    if (last_frame->msg_type != msg::type::PageEnd)
+                    {
+                        continue;
+                    }
+                    page_index_entry entry = {};
+                    entry.page_id = page_id;
+                    entry.begin_time = page->begin_time();
+                    entry.end_time = page->end_time();
+                    if (persist)
+                    {
+                        auto address = page->first_frame_address();
+                        while (address < page->last_frame_address() and reinterpret_cast<frame_header *>(address)->length > 0)
+                        {
+                            address += reinterpret_cast<frame_header *>(address)->length;
+                            entry.frame_count++;
+                        }
+                    }
+                    entries.push_back(entry);
+                }
+                if (persist and not entries.empty())
+                {
+                    std::ofstream index_file(get_index_path(location, dest_id), std::ios::binary | std::ios::trunc);
+                    index_file.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(page_index_entry));
+                    SPDLOG_INFO("rebuilt page index for {}/{:08x} with {} closed pages", location->uname, dest_id, entries.size());
+                }
+                return entries;
+            }
+
+            void page_index::append(const std::string &index_path, const page_index_entry &entry)
+            {
+                std::ofstream index_file(index_path, std::ios::binary | std::ios::app);
+                if (not index_file.write(reinterpret_cast<const char *>(&entry), sizeof(page_index_entry)))
+                {
+                    SPDLOG_ERROR("can not append page {} to index {}", entry.page_id, index_path);
+                }
+            }
+
+            int page_index::find_page_id(const std::vector<page_index_entry> &entries, int64_t time)
+            {
+                if (entries.empty())
                 {
                     return 1;
                 }
                 if (time == 0)
                 {
-                    return page_ids.front();
+                    return entries.front().page_id;
                 }
-                for (int i = page_ids.size() - 1; i >= 0; i--)
+                auto it = std::lower_bound(entries.begin(), entries.end(), time,
+                                           [](const page_index_entry &entry, int64_t t)
+                                           { return entry.begin_time < t; });
+                if (it == entries.begin())
                 {
-                    auto page = page::load(location, dest_id, page_ids[i], false, true);
-                    auto page_begin_time = page->begin_time();
-                    if (page_begin_time < time)
-                    {
-                        return page_ids[i];
-                    }
+                    return entries.front().page_id;
                 }
-                return page_ids.front();
+                const auto &entry = *(--it);
+                return time >= entry.end_time ? entry.page_id + 1 : entry.page_id;
             }
+
+            std::string frame_index::get_index_path(const data::location_ptr &location, uint32_t dest_id, int page_id)
+            {
+                return fmt::format("{}/{:08x}.{}.index", location->locator->layout_dir(location, data::layout::JOURNAL), dest_id, page_id);
+            }
+
+            std::vector<frame_index_entry> frame_index::load(const data::location_ptr &location, uint32_t dest_id, int page_id)
+            {
+                std::vector<frame_index_entry> entries;
+                std::ifstream index_file(get_index_path(location, dest_id, page_id), std::ios::binary | std::ios::ate);
+                if (index_file.good())
+                {
+                    entries.resize(index_file.tellg() / sizeof(frame_index_entry));
+                    index_file.seekg(0);
+                    index_file.read(reinterpret_cast<char *>(entries.data()), entries.size() * sizeof(frame_index_entry));
+                    entries.resize(index_file.gcount() / sizeof(frame_index_entry));
+                }
+                // the file is mapped by writer at full capacity, entries end at the first slot not yet written
+                auto end = std::find_if(entries.begin(), entries.end(), [](const frame_index_entry &entry)
+                { return entry.gen_time == 0; });
+                entries.erase(end, entries.end());
+                return entries;
+            }
+
+            const frame_index_entry *frame_index::find(const std::vector<frame_index_entry> &entries, int64_t time)
+            {
+                auto it = std::upper_bound(entries.begin(), entries.end(), time,
+                                           [](int64_t t, const frame_index_entry &entry)
+                                           { return t < entry.gen_time; });
+                return it == entries.begin() ? nullptr : &(*(--it));
+            }
+        }
+
+        uint32_t data::locator::page_size(location_ptr location, uint32_t dest_id) const
+        {
+            return journal::find_page_size(location, dest_id);
         }
     }
 }
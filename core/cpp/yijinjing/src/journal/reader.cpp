@@ -14,6 +14,7 @@
  *****************************************************************************/
 
 #include <utility>
+#include <algorithm>
 #include <spdlog/spdlog.h>
 
 #include <kungfu/yijinjing/time.h>
@@ -30,11 +31,14 @@ namespace kungfu
         {
             reader::~reader()
             {
+                heap_.clear();
+                parked_.clear();
                 journals_.clear();
             }
 
             void
-            reader::join(const data::location_ptr &location, uint32_t dest_id, const int64_t from_time)
+            reader::join(const data::location_ptr &location, uint32_t dest_id, const int64_t from_time,
+                         const frame_filter &filter)
             {
                 for (const auto &journal : journals_)
                 {
@@ -45,11 +49,11 @@ namespace kungfu
                     }
                 }
                 journals_.push_back(std::make_shared<journal>(location, dest_id, false, lazy_));
+                journals_.back()->readahead_ = readahead_;
                 journals_.back()->seek_to_time(from_time);
-                if (current_ == nullptr)
-                {
-                    sort(); // do not sort if current_ is set (because we could be in process of reading)
-                }
+                journals_.back()->filter_ = filter;
+                // park it, heap is not touched here because we could be in process of reading current_
+                parked_.push_back(journals_.back().get());
             }
 
             void reader::disjoin(const uint32_t location_uid)
@@ -63,8 +67,34 @@ namespace kungfu
 
             bool reader::data_available()
             {
-                sort();
-                return current_ != nullptr && current_frame()->has_data();
+                // a parked journal may have got a frame earlier than heap head, take it in before picking the head
+                probe_parked();
+                if (heap_.empty())
+                {
+                    return false;
+                }
+                if (heap_.front()->frame_->gen_time() > now_)
+                {
+                    now_ = time::now_in_nano();
+                    if (heap_.front()->frame_->gen_time() > now_)
+                    {
+                        return false;
+                    }
+                }
+                current_ = heap_.front();
+                return true;
+            }
+
+            void reader::get_location_uids(std::vector<uint32_t> &uids) const
+            {
+                uids.clear();
+                for (const auto &journal : journals_)
+                {
+                    if (std::find(uids.begin(), uids.end(), journal->location_->uid) == uids.end())
+                    {
+                        uids.push_back(journal->location_->uid);
+                    }
+                }
             }
 
             void reader::seek_to_time(int64_t nanotime)
@@ -78,26 +108,82 @@ namespace kungfu
 
             void reader::next()
             {
-                if(current_ != nullptr)
+                if (current_ == nullptr || heap_.empty() || heap_.front() != current_)
                 {
-                    current_->next();
+                    return;
+                }
+                pop_heap();
+                current_->next();
+                if (skip_filtered(current_))
+                {
+                    push_heap(current_);
+                } else
+                {
+                    parked_.push_back(current_);
                 }
-                sort();
             }
 
             void reader::sort()
             {
-                int64_t min_time = time::now_in_nano();
+                heap_.clear();
+                parked_.clear();
                 for (const auto &journal : journals_)
                 {
-                    const auto &&frame = journal->current_frame();
-                    if (frame->has_data() && frame->gen_time() <= min_time)
+                    parked_.push_back(journal.get());
+                }
+                probe_parked();
+            }
+
+            void reader::probe_parked()
+            {
+                size_t i = 0;
+                while (i < parked_.size())
+                {
+                    journal *j = parked_[i];
+                    if (skip_filtered(j))
+                    {
+                        push_heap(j);
+                        parked_[i] = parked_.back();
+                        parked_.pop_back();
+                    } else
                     {
-                        min_time = frame->gen_time();
-                        current_ = journal.get();
+                        i++;
                     }
                 }
             }
+
+            bool reader::skip_filtered(journal *j)
+            {
+                const frame_ptr &frame = j->frame_;
+                if (j->filter_.accept_all())
+                {
+                    return frame->has_data();
+                }
+                while (frame->has_data() && !j->filter_.match(reinterpret_cast<const frame_header *>(frame->address())))
+                {
+                    j->next();
+                }
+                return frame->has_data();
+            }
+
+            bool reader::later(const journal *a, const journal *b)
+            {
+                return a->frame_->gen_time() > b->frame_->gen_time();
+            }
+
+            void reader::push_heap(journal *j)
+            {
+                heap_.push_back(j);
+                std::push_heap(heap_.begin(), heap_.end(), later);
+            }
+
+            journal *reader::pop_heap()
+            {
+                std::pop_heap(heap_.begin(), heap_.end(), later);
+                journal *j = heap_.back();
+                heap_.pop_back();
+                return j;
+            }
         }
     }
 }
\ No newline at end of file
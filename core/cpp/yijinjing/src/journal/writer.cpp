@@ -15,6 +15,8 @@
 
 #include <utility>
 #include <mutex>
+#include <algorithm>
+#include <fmt/format.h>
 
 #include <kungfu/yijinjing/common.h>
 #include <kungfu/yijinjing/time.h>
@@ -33,14 +35,43 @@ namespace kungfu
         {
             constexpr uint32_t PAGE_ID_TRANC    = 0xFFFF0000;
             constexpr uint32_t FRAME_ID_TRANC   = 0x0000FFFF;
+            constexpr uint64_t OFFSET_MASK      = 0x00000000FFFFFFFF;
 
             writer::writer(const data::location_ptr& location, uint32_t dest_id, bool lazy, publisher_ptr publisher) :
                     publisher_(std::move(publisher)), size_to_write_(0)
             {
                 frame_id_base_ = location->uid ^ dest_id;
                 frame_id_base_ = frame_id_base_ << 32;
+                page_index_path_ = page_index::get_index_path(location, dest_id);
                 journal_ = std::make_shared<journal>(location, dest_id, true, lazy);
-                journal_->seek_to_time(time::now_in_nano());
+                std::vector<frame_index_entry> frame_index;
+                journal_->seek_to_end(frame_index);
+                // drop entries left beyond the resumed frame, and put back those recovered by scanning
+                journal_->current_page_->restore_frame_index(frame_index);
+                if (journal_->current_page_->get_version() < __JOURNAL_VERSION__)
+                {
+                    // never mix frame layouts in one page, older page with frames is closed, a new page is started
+                    close_page(time::now_in_nano());
+                }
+                release();
+            }
+
+            writer::~writer()
+            {
+                auto &page = journal_->current_page_;
+                page_persister::instance().flush();
+                if (page->is_in_shm())
+                {
+                    // persist live page as well, so that nothing written is lost if memory resident copy is gone
+                    try
+                    {
+                        page_persister::copy(page, page::get_durable_page_path(journal_->location_, journal_->dest_id_, page->get_page_id()));
+                    }
+                    catch (const journal_error &e)
+                    {
+                        SPDLOG_ERROR("{}", e.what());
+                    }
+                }
             }
 
             uint64_t writer::current_frame_uid()
@@ -53,18 +84,16 @@ namespace kungfu
             frame_ptr writer::open_frame(int64_t trigger_time, int32_t msg_type, uint32_t data_length)
             {
                 assert(sizeof(frame_header) + data_length + sizeof(frame_header) <= journal_->current_page_->get_page_size());
-                int64_t t = time::now_in_nano();
-                while (not writer_mtx_.try_lock())
-                {
-                    if (time::now_in_nano() - t > time_unit::NANOSECONDS_PER_MILLISECOND)
-                    {
-                        throw journal_error("Can not lock writer for " + journal_->location_->uname);
-                    }
-                }
+                acquire();
                 if (journal_->current_frame()->address() + sizeof(frame_header) + data_length > journal_->current_page_->address_border())
                 {
                     close_page(trigger_time);
                 }
+                return init_frame(trigger_time, msg_type);
+            }
+
+            frame_ptr writer::init_frame(int64_t trigger_time, int32_t msg_type)
+            {
                 auto frame = journal_->current_frame();
                 frame->set_header_length();
                 frame->set_trigger_time(trigger_time);
@@ -76,60 +105,307 @@ namespace kungfu
 
             void writer::close_frame(size_t data_length)
             {
-                auto frame = journal_->current_frame();
-                auto next_frame_address = frame->address() + frame->header_length() + data_length;
-                assert(next_frame_address < journal_->current_page_->address_border());
+                auto &frame = journal_->current_frame();
+                auto next_frame_address = frame->address() + align_frame_length(frame->header_length() + data_length);
+                assert(next_frame_address <= journal_->current_page_->address_border());
                 memset(reinterpret_cast<void *>(next_frame_address), 0, sizeof(frame_header));
                 frame->set_gen_time(time::now_in_nano());
                 frame->set_data_length(data_length);
                 journal_->current_page_->set_last_frame_position(frame->address() - journal_->current_page_->address());
+                index_frame();
                 journal_->next();
-                writer_mtx_.unlock();
-                publisher_->notify();
+                release();
+                publisher_->notify_location(journal_->location_->uid);
             }
 
             void writer::mark(int64_t trigger_time, int32_t msg_type)
             {
-                open_frame(trigger_time, msg_type, 0);
-                close_frame(0);
+                write_raw(trigger_time, msg_type, 0, 0);
             }
 
             void writer::mark_with_time(int64_t gen_time, int32_t msg_type)
             {
-                assert(sizeof(frame_header) + sizeof(frame_header) <= journal_->current_page_->get_page_size());
-                if (journal_->current_frame()->address() + sizeof(frame_header) > journal_->current_page_->address_border())
+                write_frame(gen_time, msg_type, gen_time, 0, 0);
+            }
+
+            void writer::write_raw(int64_t trigger_time, int32_t msg_type, uintptr_t data, uint32_t length)
+            {
+                write_frame(trigger_time, msg_type, 0, data, length);
+                publisher_->notify_location(journal_->location_->uid);
+            }
+
+            template<>
+            void writer::write(int64_t trigger_time, int32_t msg_type, const std::string &data)
+            {
+                write_raw(trigger_time, msg_type, reinterpret_cast<uintptr_t>(data.c_str()), data.length());
+            }
+
+            void writer::write_frame(int64_t trigger_time, int32_t msg_type, int64_t gen_time, uintptr_t data, uint32_t length)
+            {
+                uint64_t position = 0;
+                uintptr_t address = reserve(align_frame_length(sizeof(frame_header) + length), trigger_time, position);
+                if (length > 0)
                 {
-                    mark(gen_time, msg::type::PageEnd);
-                    journal_->load_next_page();
+                    memcpy(reinterpret_cast<void *>(address + sizeof(frame_header)), reinterpret_cast<void *>(data), length);
                 }
-                auto frame = journal_->current_frame();
+                commit(position, trigger_time, msg_type, gen_time, length);
+            }
+
+            uintptr_t writer::reserve(uint32_t frame_length, int64_t trigger_time, uint64_t &position)
+            {
+                uint32_t spins = 0;
+                while (true)
+                {
+                    position = reserve_cursor_.load(std::memory_order_acquire);
+                    if (position == 0)
+                    {
+                        backoff(spins);
+                        continue;
+                    }
+                    uintptr_t page_address = page_address_.load(std::memory_order_relaxed);
+                    uint32_t page_border = page_border_.load(std::memory_order_relaxed);
+                    uint32_t offset = position & OFFSET_MASK;
+                    if (offset + frame_length <= page_border)
+                    {
+                        if (reserve_cursor_.compare_exchange_weak(position, position + frame_length, std::memory_order_acq_rel))
+                        {
+                            return page_address + offset;
+                        }
+                    } else if (reserve_cursor_.compare_exchange_weak(position, 0, std::memory_order_acq_rel))
+                    {
+                        wait_commit(position);
+                        if (offset == journal_->current_page_->first_frame_address() - page_address)
+                        {
+                            release();
+                            throw journal_error(fmt::format("frame length {} exceeds page size of {}", frame_length, journal_->location_->uname));
+                        }
+                        close_page(trigger_time);
+                        release();
+                    }
+                }
+            }
+
+            void writer::commit(uint64_t position, int64_t trigger_time, int32_t msg_type, int64_t gen_time, uint32_t data_length)
+            {
+                wait_commit(position);
+                auto &frame = journal_->current_frame();
+                assert(frame->address() == page_address_ + (position & OFFSET_MASK));
                 frame->set_header_length();
-                frame->set_trigger_time(gen_time);
+                frame->set_trigger_time(trigger_time);
                 frame->set_msg_type(msg_type);
                 frame->set_source(journal_->location_->uid);
                 frame->set_dest(journal_->dest_id_);
-                memset(reinterpret_cast<void *>(frame->address() + frame->header_length()), 0, sizeof(frame_header));
-                frame->set_gen_time(gen_time);
-                frame->set_data_length(0);
+                memset(reinterpret_cast<void *>(frame->address() + align_frame_length(frame->header_length() + data_length)), 0, sizeof(frame_header));
+                frame->set_gen_time(gen_time == 0 ? time::now_in_nano() : gen_time);
+                frame->set_data_length(data_length);
                 journal_->current_page_->set_last_frame_position(frame->address() - journal_->current_page_->address());
+                index_frame();
                 journal_->next();
+                commit_cursor_.store(position + align_frame_length(sizeof(frame_header) + data_length), std::memory_order_release);
             }
 
-            void writer::write_raw(int64_t trigger_time, int32_t msg_type, uintptr_t data, uint32_t length)
+            void writer::acquire()
+            {
+                uint32_t spins = 0;
+                while (true)
+                {
+                    uint64_t position = reserve_cursor_.load(std::memory_order_acquire);
+                    if (position != 0 and reserve_cursor_.compare_exchange_weak(position, 0, std::memory_order_acq_rel))
+                    {
+                        wait_commit(position);
+                        return;
+                    }
+                    backoff(spins);
+                }
+            }
+
+            void writer::release()
+            {
+                auto page = journal_->current_page_;
+                uint64_t position = (static_cast<uint64_t>(page->get_page_id()) << 32u) | (journal_->current_frame()->address() - page->address());
+                page_address_.store(page->address(), std::memory_order_relaxed);
+                page_border_.store(page->address_border() - page->address(), std::memory_order_relaxed);
+                commit_cursor_.store(position, std::memory_order_relaxed);
+                reserve_cursor_.store(position, std::memory_order_release);
+            }
+
+            frame_ptr writer::open_batch_frame(frame_batch &batch, int64_t trigger_time, int32_t msg_type, uint32_t data_length)
+            {
+                assert(sizeof(frame_header) + data_length + sizeof(frame_header) <= journal_->current_page_->get_page_size());
+                if (journal_->current_frame()->address() + sizeof(frame_header) + data_length > journal_->current_page_->address_border())
+                {
+                    publish_batch(batch);
+                    close_page(trigger_time);
+                }
+                return init_frame(trigger_time, msg_type);
+            }
+
+            void writer::close_batch_frame(frame_batch &batch, size_t data_length)
+            {
+                auto &frame = journal_->current_frame();
+                uint32_t frame_length = align_frame_length(frame->header_length() + data_length);
+                assert(frame->address() + frame_length <= journal_->current_page_->address_border());
+                memset(reinterpret_cast<void *>(frame->address() + frame_length), 0, sizeof(frame_header));
+                frame->set_gen_time(time::now_in_nano());
+                if (batch.pending_address_ == 0)
+                {
+                    frame->header_->data_length = data_length;
+                    batch.pending_address_ = frame->address();
+                    batch.pending_length_ = frame_length;
+                } else
+                {
+                    frame->set_data_length(data_length);
+                }
+                batch.last_frame_address_ = frame->address();
+                batch.frame_count_++;
+                index_frame();
+                frame->set_address(frame->address() + frame_length);
+                journal_->page_frame_nb_++;
+            }
+
+            void writer::publish_batch(frame_batch &batch)
+            {
+                if (batch.pending_address_ == 0)
+                {
+                    return;
+                }
+                journal_->current_page_->set_last_frame_position(batch.last_frame_address_ - journal_->current_page_->address());
+                store_release(reinterpret_cast<volatile uint32_t *>(batch.pending_address_), batch.pending_length_);
+                batch.pending_address_ = 0;
+            }
+
+            frame_batch::frame_batch(writer_ptr writer) :
+                    writer_(std::move(writer)), committed_(false), frame_count_(0), pending_address_(0), pending_length_(0), last_frame_address_(0)
+            {
+                writer_->acquire();
+            }
+
+            frame_batch::~frame_batch()
+            {
+                commit();
+            }
+
+            void frame_batch::write_raw(int64_t trigger_time, int32_t msg_type, uintptr_t data, uint32_t length)
             {
                 auto frame = open_frame(trigger_time, msg_type, length);
-                memcpy(const_cast<void*>(frame->data_address()), reinterpret_cast<void*>(data), length);
+                if (length > 0)
+                {
+                    memcpy(reinterpret_cast<void *>(frame->address() + frame->header_length()), reinterpret_cast<void *>(data), length);
+                }
                 close_frame(length);
             }
-            template<>
-            void writer::write(int64_t trigger_time, int32_t msg_type, const std::string &data)
+
+            void frame_batch::commit()
             {
-                write_raw(trigger_time, msg_type, reinterpret_cast<uintptr_t>(data.c_str()), data.length());
+                if (committed_)
+                {
+                    return;
+                }
+                committed_ = true;
+                writer_->publish_batch(*this);
+                writer_->release();
+                if (frame_count_ > 0)
+                {
+                    writer_->publisher_->notify_location(writer_->get_location()->uid);
+                }
+            }
+
+            frame_builder::frame_builder(writer_ptr writer, int64_t trigger_time, int32_t msg_type, uint32_t max_length) :
+                    writer_(std::move(writer)), batch_(nullptr), trigger_time_(trigger_time), max_length_(max_length), committed_(false),
+                    failed_(false)
+            {
+                reset_put_area(writer_->open_frame(trigger_time, msg_type, 0));
+            }
+
+            frame_builder::frame_builder(frame_batch &batch, int64_t trigger_time, int32_t msg_type, uint32_t max_length) :
+                    writer_(batch.writer_), batch_(&batch), trigger_time_(trigger_time), max_length_(max_length), committed_(false),
+                    failed_(false)
+            {
+                reset_put_area(writer_->open_batch_frame(batch, trigger_time, msg_type, 0));
+            }
+
+            frame_builder::~frame_builder()
+            {
+                commit();
+            }
+
+            void frame_builder::commit()
+            {
+                if (committed_)
+                {
+                    return;
+                }
+                committed_ = true;
+                if (failed_)
+                {
+                    // frame length is still 0, readers never see it, its space is taken by the next frame
+                    SPDLOG_ERROR("drop frame of msg type {} to {}/{:08x}, data exceeds max length {} or page size", frame_->msg_type(),
+                                 writer_->get_location()->uname, writer_->get_dest(), max_length_);
+                    if (batch_ == nullptr)
+                    {
+                        writer_->release();
+                    }
+                    return;
+                }
+                if (batch_ != nullptr)
+                {
+                    writer_->close_batch_frame(*batch_, length());
+                } else
+                {
+                    writer_->close_frame(length());
+                }
+            }
+
+            frame_builder::int_type frame_builder::overflow(int_type ch)
+            {
+                if (traits_type::eq_int_type(ch, traits_type::eof()))
+                {
+                    return traits_type::not_eof(ch);
+                }
+                if (failed_)
+                {
+                    return traits_type::eof();
+                }
+                uint32_t written = length();
+                if (written >= max_length_)
+                {
+                    failed_ = true;
+                    return traits_type::eof();
+                }
+                // page border reached before max length, carry what is written so far to the next page
+                std::vector<char> buffer(pbase(), pptr());
+                if (batch_ != nullptr)
+                {
+                    writer_->publish_batch(*batch_);
+                }
+                auto msg_type = frame_->msg_type();
+                writer_->close_page(trigger_time_);
+                reset_put_area(writer_->init_frame(trigger_time_, msg_type));
+                if (epptr() - pbase() < written + 1)
+                {
+                    // ostream swallows exceptions thrown from streambuf, fail the frame so that commit drops it
+                    failed_ = true;
+                    return traits_type::eof();
+                }
+                memcpy(pbase(), buffer.data(), written);
+                pbump(written);
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+                return ch;
+            }
+
+            void frame_builder::reset_put_area(frame_ptr frame)
+            {
+                frame_ = std::move(frame);
+                auto begin = reinterpret_cast<char *>(frame_->address() + frame_->header_length());
+                auto border = reinterpret_cast<char *>(writer_->current_page_border());
+                setp(begin, std::min(border, begin + max_length_));
             }
 
             void writer::close_page(int64_t trigger_time)
             {
                 page_ptr last_page = journal_->current_page_;
+                uint32_t frame_count = journal_->page_frame_nb_;
                 journal_->load_next_page();
 
                 frame last_page_frame;
@@ -143,6 +419,21 @@ namespace kungfu
                 last_page_frame.set_gen_time(time::now_in_nano());
                 last_page_frame.set_data_length(0);
                 last_page->set_last_frame_position(last_page_frame.address() - last_page->address());
+
+                page_index_entry entry = {};
+                entry.page_id = last_page->get_page_id();
+                entry.frame_count = frame_count;
+                entry.begin_time = last_page->begin_time();
+                entry.end_time = last_page->end_time();
+                page_persister::instance().append_index(page_index_path_, entry);
+
+                if (last_page->is_in_shm())
+                {
+                    auto durable_path = page::get_durable_page_path(journal_->location_, journal_->dest_id_, entry.page_id);
+                    std::string retired_path = entry.page_id > SHM_PAGE_RETAIN ?
+                                               page::get_shm_page_path(journal_->location_, journal_->dest_id_, entry.page_id - SHM_PAGE_RETAIN) : "";
+                    page_persister::instance().persist(last_page, durable_path, retired_path);
+                }
             }
         }
     }
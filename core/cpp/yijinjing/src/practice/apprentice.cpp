@@ -157,48 +157,43 @@ namespace kungfu
                   now_ = event->gen_time();
               });
 
-            events_ | is(msg::type::Location) |
-            $([&](event_ptr e)
+            on(msg::type::Location, [&](const event_ptr &e)
               {
                   register_location_from_event(e);
               });
 
-            events_ | is(msg::type::Channel) |
-            $([&](event_ptr e)
+            on(msg::type::Channel, [&](const event_ptr &e)
               {
                     auto& channel = e->data<msg::data::Channel>();
                     register_channel(e->gen_time(), channel);
               });
 
-            events_ | is(msg::type::Register) |
-            $([&](event_ptr e)
+            on(msg::type::Register, [&](const event_ptr &e)
               {
                   register_location_from_event(e);
               });
 
-            events_ | is(msg::type::Deregister) |
-            $([&](event_ptr e)
+            on(msg::type::Deregister, [&](const event_ptr &e)
               {
                   deregister_location_from_event(e);
               });
 
-            events_ | is(msg::type::RequestWriteTo) |
-            $([&](event_ptr e)
+            on(msg::type::RequestWriteTo, [&](const event_ptr &e)
               {
                   on_write_to(e);
               });
 
-            events_ | filter([&](event_ptr e)
-                             {
-                                 return e->msg_type() == msg::type::RequestReadFromPublic or e->msg_type() == msg::type::RequestReadFrom;
-                             }) |
-            $([&](event_ptr e)
+            on(msg::type::RequestReadFrom, [&](const event_ptr &e)
               {
                   on_read_from(e);
               });
 
-            events_ | is(msg::type::TradingDay) |
-            $([&](event_ptr e)
+            on(msg::type::RequestReadFromPublic, [&](const event_ptr &e)
+              {
+                  on_read_from(e);
+              });
+
+            on(msg::type::TradingDay, [&](const event_ptr &e)
               {
                   on_trading_day(e, e->data<int64_t>());
               });
@@ -257,7 +252,7 @@ namespace kungfu
                         get_location(request.source_id)->uname, request.source_id, time::strftime(event->gen_time()),
                         time::strftime(request.from_time));
             uint32_t dest_id = event->msg_type() == msg::type::RequestReadFromPublic ? 0 : get_live_home_uid();
-            reader_->join(get_location(request.source_id), dest_id, request.from_time);
+            reader_->join(get_location(request.source_id), dest_id, request.from_time, interests_);
         }
 
         void apprentice::checkin()
@@ -3,6 +3,10 @@
 //
 
 #include <utility>
+#include <sstream>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <spdlog/spdlog.h>
 
 #include <kungfu/yijinjing/msg.h>
@@ -24,6 +28,64 @@ namespace kungfu
 {
     namespace practice
     {
+        /** e.g. KF_CPU_AFFINITY=2,3 KF_RT_PRIORITY=50 KF_LOCK_MEMORY=1, set by kfc options of the same names */
+        constexpr const char *CPU_AFFINITY_ENV = "KF_CPU_AFFINITY";
+        constexpr const char *RT_PRIORITY_ENV = "KF_RT_PRIORITY";
+        constexpr const char *LOCK_MEMORY_ENV = "KF_LOCK_MEMORY";
+
+        /** @return false if value is not an integer in whole */
+        static bool parse_int(const std::string &value, int &result)
+        {
+            char *end = nullptr;
+            errno = 0;
+            long parsed = std::strtol(value.c_str(), &end, 10);
+            if (value.empty() or end != value.c_str() + value.size() or errno == ERANGE or parsed < INT_MIN or parsed > INT_MAX)
+            {
+                return false;
+            }
+            result = static_cast<int>(parsed);
+            return true;
+        }
+
+        static os::runtime_policy read_runtime_policy(const data::locator_ptr &locator)
+        {
+            os::runtime_policy policy;
+            if (locator->has_env(CPU_AFFINITY_ENV))
+            {
+                std::stringstream cpus(locator->get_env(CPU_AFFINITY_ENV));
+                std::string cpu;
+                while (std::getline(cpus, cpu, ','))
+                {
+                    int value = 0;
+                    if (cpu.empty())
+                    {
+                        continue;
+                    }
+                    if (parse_int(cpu, value))
+                    {
+                        policy.cpu_affinity.push_back(value);
+                    } else
+                    {
+                        policy.errors.push_back(fmt::format("bad {} value [{}] ignored", CPU_AFFINITY_ENV, cpu));
+                    }
+                }
+            }
+            if (locator->has_env(RT_PRIORITY_ENV) and not locator->get_env(RT_PRIORITY_ENV).empty())
+            {
+                auto priority = locator->get_env(RT_PRIORITY_ENV);
+                if (not parse_int(priority, policy.rt_priority))
+                {
+                    policy.errors.push_back(fmt::format("bad {} value [{}] ignored", RT_PRIORITY_ENV, priority));
+                }
+            }
+            if (locator->has_env(LOCK_MEMORY_ENV))
+            {
+                auto lock = locator->get_env(LOCK_MEMORY_ENV);
+                policy.lock_memory = not lock.empty() and lock != "0" and lock != "false";
+            }
+            return policy;
+        }
+
 
         hero::hero(yijinjing::io_device_with_reply_ptr io_device) :
                 io_device_(std::move(io_device)), now_(0), begin_time_(time::now_in_nano()), end_time_(INT64_MAX)
@@ -36,6 +98,63 @@ namespace kungfu
             reader_ = io_device_->open_reader_to_subscribe();
         }
 
+        void hero::on(int32_t msg_type, const event_handler &handler)
+        {
+            add_handler(msg_type, {false, false, 0, 0, handler, nullptr});
+        }
+
+        void hero::on_from(int32_t msg_type, uint32_t source, const event_handler &handler)
+        {
+            add_handler(msg_type, {true, false, source, 0, handler, nullptr});
+        }
+
+        void hero::on_to(int32_t msg_type, uint32_t dest, const event_handler &handler)
+        {
+            add_handler(msg_type, {false, true, 0, dest, handler, nullptr});
+        }
+
+        void hero::add_handler(int32_t msg_type, const dispatch_entry &entry)
+        {
+            dispatch_table_[msg_type].push_back(entry);
+        }
+
+        void hero::dispatch(const rx::subscriber<yijinjing::event_ptr> &sb, const yijinjing::event_ptr &event,
+                            const journal::frame *frame)
+        {
+            auto it = dispatch_table_.find(event->msg_type());
+            if (it != dispatch_table_.end())
+            {
+                auto &entries = it->second;
+                // handlers registered during dispatch only see later events, same as rx subscribers
+                for (size_t i = 0, count = entries.size(); i < count; i++)
+                {
+                    auto &entry = entries[i];
+                    if ((entry.match_source and event->source() != entry.source) or (entry.match_dest and event->dest() != entry.dest))
+                    {
+                        continue;
+                    }
+                    if (entry.typed_handler and frame == nullptr)
+                    {
+                        continue;
+                    }
+                    try
+                    {
+                        if (entry.typed_handler)
+                        {
+                            entry.typed_handler(event, *frame);
+                        } else
+                        {
+                            entry.handler(event);
+                        }
+                    } catch (...)
+                    {
+                        interrupt_on_error(std::current_exception());
+                    }
+                }
+            }
+            sb.on_next(event);
+        }
+
         bool hero::has_location(uint32_t hash)
         {
             return locations_.find(hash) != locations_.end();
@@ -90,6 +209,7 @@ namespace kungfu
         {
             SPDLOG_INFO("{} [{:08x}] running", get_home_uname(), get_home_uid());
             SPDLOG_INFO("from {} until {}", time::strftime(begin_time_), end_time_ == INT64_MAX ? "end of world" : time::strftime(end_time_));
+            SPDLOG_INFO("runtime policy: {}", os::apply_runtime_policy(read_runtime_policy(io_device_->get_home()->locator)));
 
             events_ = observable<>::create<event_ptr>(
                     [&, this](subscriber<event_ptr> sb)
@@ -131,6 +251,17 @@ namespace kungfu
             events_.connect();
 
             on_exit();
+            if (io_device_->get_home()->mode == mode::LIVE)
+            {
+                auto &stats = io_device_->get_wait_stats();
+                SPDLOG_INFO("idle {} times, woke {} by spin {} by yield {} by block, {} timeouts, spin {}ms block {}ms, "
+                            "wakeup latency mean {:.1f}us max {:.1f}us",
+                            stats.idle_count, stats.spin_wakeup_count, stats.yield_wakeup_count, stats.block_wakeup_count,
+                            stats.timeout_count, stats.spin_time / time_unit::NANOSECONDS_PER_MILLISECOND,
+                            stats.block_time / time_unit::NANOSECONDS_PER_MILLISECOND,
+                            stats.get_wakeup_latency_mean() / time_unit::NANOSECONDS_PER_MICROSECOND,
+                            double(stats.wakeup_latency_max) / time_unit::NANOSECONDS_PER_MICROSECOND);
+            }
             SPDLOG_INFO("{} finished", get_home_uname());
         }
 
@@ -254,7 +385,7 @@ namespace kungfu
                     now_ = time::now_in_nano();
                     if (notice.length() > 2)
                     {
-                        sb.on_next(std::make_shared<nanomsg_json>(notice));
+                        dispatch(sb, json_pool_.acquire(notice), nullptr);
                     } else
                     {
                         on_notify();
@@ -264,15 +395,17 @@ namespace kungfu
                 {
                     const std::string &msg = io_device_->get_rep_sock()->last_message();
                     now_ = time::now_in_nano();
-                    sb.on_next(std::make_shared<nanomsg_json>(msg));
+                    dispatch(sb, json_pool_.acquire(msg), nullptr);
                 }
             }
             while (reader_->data_available())
             {
-                if (reader_->current_frame()->gen_time() <= end_time_)
+                const frame_ptr &frame = reader_->current_frame();
+                if (frame->gen_time() <= end_time_)
                 {
-                    now_ = reader_->current_frame()->gen_time();
-                    sb.on_next(reader_->current_frame());
+                    now_ = frame->gen_time();
+                    // non-owning view of the frame, copies along handlers and rx operators touch no refcount
+                    dispatch(sb, event_ptr(event_ptr(), frame.get()), frame.get());
                     reader_->next();
                 } else
                 {
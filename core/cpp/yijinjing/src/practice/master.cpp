@@ -2,7 +2,10 @@
 // Created by Keren Dong on 2019-06-15.
 //
 
+#include <algorithm>
+#include <functional>
 #include <typeinfo>
+#include <ostream>
 #include <nlohmann/json.hpp>
 #include <fmt/format.h>
 #include <spdlog/spdlog.h>
@@ -22,8 +25,10 @@ namespace kungfu
 {
     namespace practice
     {
+        constexpr uint32_t JSON_FRAME_MAX_LENGTH = 4 * KB;
 
-        master::master(location_ptr home, bool low_latency) : hero(std::make_shared<io_device_master>(home, low_latency)), last_check_(0)
+        master::master(location_ptr home, bool low_latency) : hero(std::make_shared<io_device_master>(home, low_latency)), last_check_(0),
+                                                             timer_generation_(0)
         {
             writers_[0] = get_io_device()->open_writer(0);
             writers_[0]->mark(time::now_in_nano(), msg::type::SessionStart);
@@ -31,6 +36,8 @@ namespace kungfu
 
         void master::on_exit()
         {
+            SPDLOG_INFO("timer tasks fired {} times, lateness mean {}ns max {}ns", timer_stats_.fire_count,
+                        timer_stats_.get_lateness_mean(), timer_stats_.lateness_max);
             writers_[0]->mark(time::now_in_nano(), msg::type::SessionEnd);
         }
 
@@ -77,10 +84,8 @@ namespace kungfu
             auto &writer = writers_[app_location->uid];
 
             {
-                auto msg = request_loc.dump();
-                auto frame = writers_[0]->open_frame(e->gen_time(), msg::type::Register, msg.length());
-                memcpy(reinterpret_cast<void *>(frame->address() + frame->header_length()), msg.c_str(), msg.length());
-                writers_[0]->close_frame(msg.length());
+                journal::frame_builder builder(writers_[0], e->gen_time(), msg::type::Register, JSON_FRAME_MAX_LENGTH);
+                std::ostream(&builder) << request_loc;
             }
 
             writer->mark(e->gen_time(), msg::type::SessionStart);
@@ -88,23 +93,24 @@ namespace kungfu
             require_write_to(app_location->uid, e->gen_time(), 0);
             require_write_to(app_location->uid, e->gen_time(), master_location->uid);
 
-            for (const auto &item : locations_)
             {
-                nlohmann::json location;
-                location["mode"] = item.second->mode;
-                location["category"] = item.second->category;
-                location["group"] = item.second->group;
-                location["name"] = item.second->name;
-                auto msg = location.dump();
-                SPDLOG_DEBUG("adding location {}", msg);
-                auto &&frame = writer->open_frame(e->gen_time(), msg::type::Location, msg.length());
-                memcpy(reinterpret_cast<void *>(frame->address() + frame->header_length()), msg.c_str(), msg.length());
-                writer->close_frame(msg.length());
-            }
+                journal::frame_batch batch(writer);
+                for (const auto &item : locations_)
+                {
+                    nlohmann::json location;
+                    location["mode"] = item.second->mode;
+                    location["category"] = item.second->category;
+                    location["group"] = item.second->group;
+                    location["name"] = item.second->name;
+                    SPDLOG_DEBUG("adding location {}", item.second->uname);
+                    journal::frame_builder builder(batch, e->gen_time(), msg::type::Location, JSON_FRAME_MAX_LENGTH);
+                    std::ostream(&builder) << location;
+                }
 
-            for(const auto& item: channels_)
-            {
-                writer->write(e->gen_time(), msg::type::Channel, item.second);
+                for (const auto &item: channels_)
+                {
+                    batch.write(e->gen_time(), msg::type::Channel, item.second);
+                }
             }
 
             on_register(e, app_location);
@@ -132,10 +138,8 @@ namespace kungfu
             writers_.erase(app_location_uid);
             timer_tasks_.erase(app_location_uid);
 
-            auto msg = location_desc.dump();
-            auto &&frame = writers_[0]->open_frame(trigger_time, msg::type::Deregister, msg.length());
-            memcpy(reinterpret_cast<void *>(frame->address() + frame->header_length()), msg.c_str(), msg.length());
-            writers_[0]->close_frame(msg.length());
+            journal::frame_builder builder(writers_[0], trigger_time, msg::type::Deregister, JSON_FRAME_MAX_LENGTH);
+            std::ostream(&builder) << location_desc;
 
         }
 
@@ -165,28 +169,7 @@ namespace kungfu
         {
             auto now = time::now_in_nano();
 
-            for (auto &app : timer_tasks_)
-            {
-                uint32_t app_id = app.first;
-                auto &app_tasks = app.second;
-                for (auto it = app_tasks.begin(); it != app_tasks.end();)
-                {
-                    auto &task = it->second;
-                    if (task.checkpoint <= now)
-                    {
-                        writers_[app_id]->mark(0, msg::type::Time);
-                        SPDLOG_DEBUG("sent time event to {}", get_location(app_id)->uname);
-                        task.checkpoint += task.duration;
-                        task.repeat_count++;
-                        if (task.repeat_count >= task.repeat_limit)
-                        {
-                            it = app_tasks.erase(it);
-                            continue;
-                        }
-                    }
-                    it++;
-                }
-            }
+            fire_timers(now);
 
             if (last_check_ + time_unit::NANOSECONDS_PER_SECOND < now)
             {
@@ -197,16 +180,62 @@ namespace kungfu
             return hero::produce_one(sb);
         }
 
+        void master::schedule_timer(uint32_t app_id, int32_t task_id, const TimerTask &task)
+        {
+            timer_queue_.push_back({task.checkpoint, app_id, task_id, task.generation});
+            std::push_heap(timer_queue_.begin(), timer_queue_.end(), std::greater<TimerCheckpoint>());
+        }
+
+        void master::fire_timers(int64_t now)
+        {
+            // a task fires at most once per loop, overdue repeats are put back and fire on later loops
+            while (not timer_queue_.empty() and timer_queue_.front().checkpoint <= now)
+            {
+                std::pop_heap(timer_queue_.begin(), timer_queue_.end(), std::greater<TimerCheckpoint>());
+                timer_due_.push_back(timer_queue_.back());
+                timer_queue_.pop_back();
+            }
+            for (const auto &due : timer_due_)
+            {
+                auto app = timer_tasks_.find(due.app_id);
+                if (app == timer_tasks_.end())
+                {
+                    continue;
+                }
+                auto &app_tasks = app->second;
+                auto it = app_tasks.find(due.task_id);
+                if (it == app_tasks.end() or it->second.generation != due.generation)
+                {
+                    continue;
+                }
+                auto &task = it->second;
+                writers_[due.app_id]->mark(0, msg::type::Time);
+                SPDLOG_DEBUG("sent time event to {}", get_location(due.app_id)->uname);
+                int64_t lateness = now - task.checkpoint;
+                timer_stats_.fire_count++;
+                timer_stats_.lateness_total += lateness;
+                timer_stats_.lateness_max = std::max(timer_stats_.lateness_max, lateness);
+                task.checkpoint += task.duration;
+                task.repeat_count++;
+                if (task.repeat_count >= task.repeat_limit)
+                {
+                    app_tasks.erase(it);
+                } else
+                {
+                    schedule_timer(due.app_id, due.task_id, task);
+                }
+            }
+            timer_due_.clear();
+        }
+
         void master::react()
         {
-            events_ | is(msg::type::Register) |
-            $([&](event_ptr e)
+            on(msg::type::Register, [&](const event_ptr &e)
               {
                   register_app(e);
               });
 
-            events_ | is(msg::type::RequestWriteTo) |
-            $([&](event_ptr e)
+            on(msg::type::RequestWriteTo, [&](const event_ptr &e)
               {
                   const msg::data::RequestWriteTo &request = e->data<msg::data::RequestWriteTo>();
                   if (has_location(request.dest_id))
@@ -224,8 +253,7 @@ namespace kungfu
                   }
               });
 
-            events_ | is(msg::type::RequestReadFrom) |
-            $([&](event_ptr e)
+            on(msg::type::RequestReadFrom, [&](const event_ptr &e)
               {
                   const msg::data::RequestReadFrom &request = e->data<msg::data::RequestReadFrom>();
                   if (has_location(request.source_id))
@@ -243,8 +271,7 @@ namespace kungfu
                   }
               });
 
-            events_ | is(msg::type::RequestReadFromPublic) |
-            $([&](event_ptr e)
+            on(msg::type::RequestReadFromPublic, [&](const event_ptr &e)
               {
                   const msg::data::RequestReadFrom &request = e->data<msg::data::RequestReadFrom>();
                   if (has_location(request.source_id))
@@ -256,8 +283,7 @@ namespace kungfu
                   }
               });
 
-            events_ | is(msg::type::TimeRequest) |
-            $([&](event_ptr e)
+            on(msg::type::TimeRequest, [&](const event_ptr &e)
               {
                   const msg::data::TimeRequest &request = e->data<msg::data::TimeRequest>();
                   if (timer_tasks_.find(e->source()) == timer_tasks_.end())
@@ -274,6 +300,8 @@ namespace kungfu
                   task.duration = request.duration;
                   task.repeat_count = 0;
                   task.repeat_limit = request.repeat;
+                  task.generation = ++timer_generation_;
+                  schedule_timer(e->source(), request.id, task);
                   SPDLOG_DEBUG("time request from {} duration {} repeat {}", get_location(e->source())->uname, request.duration, request.repeat);
               });
         }
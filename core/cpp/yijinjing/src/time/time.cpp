@@ -14,45 +14,223 @@
  *****************************************************************************/
 
 #include <chrono>
+#include <cstdlib>
+#include <climits>
 #include <iomanip>
 #include <sstream>
 #include <ctime>
-#include <regex>
+#include <cstring>
+#include <algorithm>
 #include <fmt/format.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define KUNGFU_HAS_TSC
+#endif
+
 #include <kungfu/yijinjing/time.h>
 
 using namespace std::chrono;
 using namespace kungfu::yijinjing;
 
+/** set to fall back to steady clock even if invariant tsc is present */
+#define NO_TSC_ENV "KF_NO_TSC"
+
+/** fixed point precision of tsc multiplier, nanoseconds per tick << TSC_SHIFT */
+constexpr int TSC_SHIFT = 24;
+/** busy wait at startup for initial calibration, later calibrations refine against a growing baseline */
+constexpr int64_t TSC_STARTUP_CALIBRATION = time_unit::NANOSECONDS_PER_MILLISECOND;
+constexpr int64_t TSC_CALIBRATION_INTERVAL = 100 * time_unit::NANOSECONDS_PER_MILLISECOND;
+constexpr int TSC_SAMPLE_TRIES = 4;
+/** max rate change when slewing tsc towards steady clock, in parts per million */
+constexpr int64_t TSC_MAX_SLEW_PPM = 1000;
+/** offset beyond which tsc steps to steady clock instead of slewing */
+constexpr int64_t TSC_MAX_OFFSET = time_unit::NANOSECONDS_PER_MILLISECOND;
+
+static bool has_invariant_tsc()
+{
+#ifdef KUNGFU_HAS_TSC
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 or eax < 0x80000007)
+    {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1u << 8u)) != 0;
+#else
+    return false;
+#endif
+}
+
+static inline int64_t read_tsc()
+{
+#ifdef KUNGFU_HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static inline int64_t scale_ticks(int64_t ticks, int64_t multiplier)
+{
+    return static_cast<int64_t>((static_cast<__int128>(ticks) * multiplier) >> TSC_SHIFT);
+}
+
 int64_t time::now_in_nano()
 {
-    auto duration = steady_clock::now().time_since_epoch().count() - get_instance().start_time_steady_;
-    return get_instance().start_time_since_epoch_ + duration;
+    auto &instance = get_instance();
+    return instance.use_tsc_ ? instance.tsc_now_in_nano() : instance.steady_now_in_nano();
 }
 
-int64_t time::strptime(const std::string &timestr, const std::string &format)
+int64_t time::steady_now_in_nano() const
 {
-    int64_t nano = 0;
-    std::string normal_timestr = timestr;
-    std::string normal_format = format;
+    return start_time_since_epoch_ + steady_clock::now().time_since_epoch().count() - start_time_steady_;
+}
 
-    std::regex nano_format_regex("%N");
-    if (std::regex_search(format, nano_format_regex))
+int64_t time::tsc_now_in_nano()
+{
+    int64_t tsc = read_tsc();
+    uint32_t sequence;
+    int64_t tsc_base, nano_base, multiplier, rate;
+    do
     {
-        normal_format = std::regex_replace(format, nano_format_regex, "");
+        sequence = tsc_sequence_.load(std::memory_order_acquire);
+        tsc_base = tsc_base_.load(std::memory_order_relaxed);
+        nano_base = tsc_nano_base_.load(std::memory_order_relaxed);
+        multiplier = tsc_multiplier_.load(std::memory_order_relaxed);
+        rate = tsc_rate_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((sequence & 1u) or sequence != tsc_sequence_.load(std::memory_order_relaxed));
 
-        std::regex nano_regex("(\\d{9})");
+    if (tsc - tsc_base > tsc_calibration_ticks_ and not tsc_calibrating_.test_and_set(std::memory_order_acquire))
+    {
+        calibrate_tsc(tsc_base, nano_base, multiplier, rate);
+        tsc_calibrating_.clear(std::memory_order_release);
+    }
+    return tsc_to_nano(tsc, tsc_base, nano_base, multiplier, rate);
+}
 
-        auto nano_begin = std::sregex_iterator(normal_timestr.begin(), normal_timestr.end(), nano_regex);
-        auto nano_end = std::sregex_iterator();
-        for (std::sregex_iterator i = nano_begin; i != nano_end; ++i)
+int64_t time::tsc_to_nano(int64_t tsc, int64_t tsc_base, int64_t nano_base, int64_t multiplier, int64_t rate) const
+{
+    int64_t ticks = tsc - tsc_base;
+    if (ticks <= tsc_calibration_ticks_)
+    {
+        return nano_base + scale_ticks(ticks, multiplier);
+    }
+    // slew is meant for one interval only, continue at plain rate until next calibration
+    return nano_base + scale_ticks(tsc_calibration_ticks_, multiplier) + scale_ticks(ticks - tsc_calibration_ticks_, rate);
+}
+
+/**
+ * sample tsc on both sides of steady clock and keep the narrowest of a few tries,
+ * so that a preemption in between does not skew calibration
+ */
+static int64_t sample_tsc(int64_t &steady)
+{
+    int64_t best_width = INT64_MAX;
+    int64_t best_tsc = 0;
+    for (int i = 0; i < TSC_SAMPLE_TRIES; i++)
+    {
+        int64_t before = read_tsc();
+        int64_t sample = steady_clock::now().time_since_epoch().count();
+        int64_t after = read_tsc();
+        if (after - before < best_width)
         {
-            std::smatch match = *i;
-            nano = stol(match.str());
-            normal_timestr = std::regex_replace(timestr, nano_regex, "");
+            best_width = after - before;
+            best_tsc = before + (after - before) / 2;
+            steady = sample;
         }
     }
+    return best_tsc;
+}
+
+void time::calibrate_tsc(int64_t tsc_base, int64_t nano_base, int64_t multiplier, int64_t plain_rate)
+{
+    int64_t steady = 0;
+    int64_t tsc = sample_tsc(steady);
+    int64_t truth = start_time_since_epoch_ + steady - start_time_steady_;
+    int64_t clock = tsc_to_nano(tsc, tsc_base, nano_base, multiplier, plain_rate);
+    int64_t offset = truth - clock;
+
+    // rate over the whole life of the process, error of the samples shrinks as baseline grows
+    auto rate = static_cast<int64_t>((static_cast<__int128>(truth - tsc_start_nano_) << TSC_SHIFT) / (tsc - tsc_start_));
+    if (offset > TSC_MAX_OFFSET or offset < -TSC_MAX_OFFSET)
+    {
+        publish_tsc_calibration(tsc, truth, rate, rate);
+        return;
+    }
+    // slew to absorb the offset within next interval, clock stays continuous and monotonic
+    int64_t slew = rate * offset / TSC_CALIBRATION_INTERVAL;
+    int64_t max_slew = rate * TSC_MAX_SLEW_PPM / 1000000;
+    slew = std::max(-max_slew, std::min(slew, max_slew));
+    publish_tsc_calibration(tsc, clock, rate + slew, rate);
+}
+
+void time::publish_tsc_calibration(int64_t tsc_base, int64_t nano_base, int64_t multiplier, int64_t rate)
+{
+    uint32_t sequence = tsc_sequence_.load(std::memory_order_relaxed);
+    tsc_sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    tsc_base_.store(tsc_base, std::memory_order_relaxed);
+    tsc_nano_base_.store(nano_base, std::memory_order_relaxed);
+    tsc_multiplier_.store(multiplier, std::memory_order_relaxed);
+    tsc_rate_.store(rate, std::memory_order_relaxed);
+    tsc_sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+/** @return true if any replaced */
+static bool replace_all(std::string &str, const std::string &from, const std::string &to)
+{
+    bool replaced = false;
+    for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.length()))
+    {
+        str.replace(pos, from.length(), to);
+        replaced = true;
+    }
+    return replaced;
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' and c <= '9';
+}
+
+static inline int parse_digits(const char *str, int count)
+{
+    int value = 0;
+    for (int i = 0; i < count; i++)
+    {
+        value = value * 10 + (str[i] - '0');
+    }
+    return value;
+}
+
+/** value of the last group of 9 digits, groups split runs of digits from their start */
+static int64_t parse_nano_field(const std::string &timestr)
+{
+    int64_t nano = 0;
+    int run = 0;
+    for (size_t i = 0; i < timestr.length(); i++)
+    {
+        run = is_digit(timestr[i]) ? run + 1 : 0;
+        if (run == 9)
+        {
+            nano = parse_digits(timestr.c_str() + i - 8, 9);
+            run = 0;
+        }
+    }
+    return nano;
+}
+
+int64_t time::strptime(const std::string &timestr, const std::string &format)
+{
+    int64_t nano = 0;
+    std::string normal_format = format;
+    if (replace_all(normal_format, "%N", ""))
+    {
+        nano = parse_nano_field(timestr);
+    }
 
     std::tm result = {};
     std::istringstream iss(timestr);
@@ -72,41 +250,121 @@ const std::string time::strftime(const int64_t nanotime, const std::string &form
     std::time_t time_since_epoch = system_clock::to_time_t(tp_epoch_system + duration_cast<system_clock::duration>(tp_diff));
 
     std::string normal_format = format;
-    std::regex nano_format_regex("%N");
-    if (std::regex_search(format, nano_format_regex))
+    if (format.find("%N") != std::string::npos)
     {
         int64_t nano = tp_diff.count() % time_unit::NANOSECONDS_PER_SECOND;
-        normal_format = std::regex_replace(format, nano_format_regex, fmt::format("{:09d}", nano));
+        replace_all(normal_format, "%N", fmt::format("{:09d}", nano));
     }
 
     std::ostringstream oss;
     oss << std::put_time(std::localtime(&time_since_epoch), normal_format.c_str());
-    if (nanotime > 0)
+    std::string result = oss.str();
+    if (nanotime <= 0)
+    {
+        std::replace_if(result.begin(), result.end(), is_digit, nanotime == 0 ? '0' : '#');
+    }
+    return result;
+}
+
+/** a local day, [midnight, next_midnight) in nano time */
+struct day_cache
+{
+    int32_t date = -1;
+    int64_t midnight = 0;
+    int64_t next_midnight = 0;
+    char yyyymmdd[9] = {};
+};
+
+static thread_local day_cache parse_day_cache;
+static thread_local day_cache format_day_cache;
+
+static int64_t local_midnight(int year, int month, int day)
+{
+    std::tm tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_isdst = -1;
+    return std::mktime(&tm) * time_unit::NANOSECONDS_PER_SECOND;
+}
+
+static void load_day(day_cache &cache, int year, int month, int day)
+{
+    cache.date = year * 10000 + month * 100 + day;
+    cache.midnight = local_midnight(year, month, day);
+    cache.next_midnight = local_midnight(year, month, day + 1);
+    int date = cache.date;
+    for (int i = 7; i >= 0; i--, date /= 10)
     {
-        return oss.str();
+        cache.yyyymmdd[i] = static_cast<char>('0' + date % 10);
     }
-    else if (nanotime == 0)
+    cache.yyyymmdd[8] = '\0';
+}
+
+int64_t time::nano_from_date_time(const char *date, const char *time_of_day, int millisecond)
+{
+    return nano_from_date_time(parse_digits(date, 4), parse_digits(date + 4, 2), parse_digits(date + 6, 2),
+                               parse_digits(time_of_day, 2), parse_digits(time_of_day + 3, 2), parse_digits(time_of_day + 6, 2),
+                               millisecond * time_unit::NANOSECONDS_PER_MILLISECOND);
+}
+
+int64_t time::nano_from_date_time(int year, int month, int day, int hour, int minute, int second, int64_t nanosecond)
+{
+    auto &cache = parse_day_cache;
+    if (cache.date != year * 10000 + month * 100 + day)
     {
-        return std::regex_replace(oss.str(), std::regex("\\d"), "0");
+        load_day(cache, year, month, day);
     }
-    else
+    return cache.midnight + hour * time_unit::NANOSECONDS_PER_HOUR + minute * time_unit::NANOSECONDS_PER_MINUTE +
+           second * time_unit::NANOSECONDS_PER_SECOND + nanosecond;
+}
+
+void time::strfday(int64_t nanotime, char *buffer)
+{
+    auto &cache = format_day_cache;
+    if (cache.date < 0 or nanotime < cache.midnight or nanotime >= cache.next_midnight)
     {
-        return std::regex_replace(oss.str(), std::regex("\\d"), "#");
+        std::time_t seconds = nanotime / time_unit::NANOSECONDS_PER_SECOND;
+        std::tm tm = {};
+#ifdef _WIN32
+        localtime_s(&tm, &seconds);
+#else
+        localtime_r(&seconds, &tm);
+#endif
+        load_day(cache, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
     }
+    memcpy(buffer, cache.yyyymmdd, sizeof(cache.yyyymmdd));
 }
 
 /**
  * start_time_steady_ sample:       867884767983511
  * start_time_since_epoch_ sample:  1560144011373015000
  */
-time::time()
+time::time() : tsc_sequence_(0), tsc_base_(0), tsc_nano_base_(0), tsc_multiplier_(0), tsc_rate_(0)
 {
     auto now = system_clock::now();
     start_time_steady_ = steady_clock::now().time_since_epoch().count();
     start_time_since_epoch_ = duration_cast<nanoseconds>(now.time_since_epoch()).count();
+
+    use_tsc_ = has_invariant_tsc() and std::getenv(NO_TSC_ENV) == nullptr;
+    if (use_tsc_)
+    {
+        int64_t steady_start = 0;
+        int64_t steady = 0;
+        tsc_start_ = sample_tsc(steady_start);
+        int64_t tsc;
+        do
+        {
+            tsc = sample_tsc(steady);
+        } while (steady - steady_start < TSC_STARTUP_CALIBRATION);
+        int64_t multiplier = ((steady - steady_start) << TSC_SHIFT) / (tsc - tsc_start_);
+        tsc_start_nano_ = start_time_since_epoch_ + steady_start - start_time_steady_;
+        tsc_calibration_ticks_ = (TSC_CALIBRATION_INTERVAL << TSC_SHIFT) / multiplier;
+        publish_tsc_calibration(tsc, start_time_since_epoch_ + steady - start_time_steady_, multiplier, multiplier);
+    }
 }
 
-const kungfu::yijinjing::time &time::get_instance()
+kungfu::yijinjing::time &time::get_instance()
 {
     static time t;
     return t;
@@ -0,0 +1,60 @@
+/*****************************************************************************
+ * Copyright [taurus.ai]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+#ifdef __linux__
+#include <ctime>
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+#include <thread>
+#include <chrono>
+#endif // __linux__
+
+#include <kungfu/yijinjing/util/os.h>
+
+namespace kungfu
+{
+    namespace yijinjing
+    {
+        namespace os
+        {
+            bool futex_wait(const volatile uint32_t *address, uint32_t expected, int timeout_ms)
+            {
+#ifdef __linux__
+                struct timespec timeout = {};
+                timeout.tv_sec = timeout_ms / 1000;
+                timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+                // no FUTEX_PRIVATE_FLAG, address lives in memory shared among processes
+                return syscall(SYS_futex, address, FUTEX_WAIT, expected, &timeout, nullptr, 0) == 0;
+#else
+                if (*address == expected)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+                }
+                return *address != expected;
+#endif // __linux__
+            }
+
+            void futex_wake(const volatile uint32_t *address)
+            {
+#ifdef __linux__
+                syscall(SYS_futex, address, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif // __linux__
+            }
+        }
+    }
+}
@@ -13,7 +13,15 @@
 #include <sys/types.h>
 #endif // _WINDOWS
 
+#ifdef __linux__
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#endif // __linux__
+
 #include <regex>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
 #include <spdlog/spdlog.h>
 
 #include <kungfu/yijinjing/journal/common.h>
@@ -27,7 +35,44 @@ namespace kungfu {
 
         namespace os {
 
-            uintptr_t load_mmap_buffer(const std::string &path, size_t size, bool is_writing, bool lazy)
+#ifdef __linux__
+            constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+            /**
+             * map file at an address aligned to huge page size, otherwise kernel can not back the head and tail
+             * of the buffer with transparent huge pages
+             * @return MAP_FAILED if failed
+             */
+            static void *mmap_huge_page_aligned(int fd, size_t size, int prot)
+            {
+                size_t reserved_size = size + HUGE_PAGE_SIZE;
+                void *reserved = mmap(0, reserved_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (reserved == MAP_FAILED)
+                {
+                    return MAP_FAILED;
+                }
+                auto reserved_address = reinterpret_cast<uintptr_t>(reserved);
+                auto aligned_address = (reserved_address + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+                void *buffer = mmap(reinterpret_cast<void *>(aligned_address), size, prot, MAP_SHARED | MAP_FIXED, fd, 0);
+                if (buffer == MAP_FAILED)
+                {
+                    munmap(reserved, reserved_size);
+                    return MAP_FAILED;
+                }
+                if (aligned_address > reserved_address)
+                {
+                    munmap(reserved, aligned_address - reserved_address);
+                }
+                size_t tail_size = reserved_address + reserved_size - (aligned_address + size);
+                if (tail_size > 0)
+                {
+                    munmap(reinterpret_cast<void *>(aligned_address + size), tail_size);
+                }
+                return buffer;
+            }
+#endif // __linux__
+
+            uintptr_t load_mmap_buffer(const std::string &path, size_t size, bool is_writing, bool lazy, bool huge_page)
             {
 #ifdef _WINDOWS
                 bool master = is_writing || !lazy;
@@ -81,7 +126,30 @@ namespace kungfu {
                     throw journal_error("failed to open file for page " + path);
                 }
 
-                if (master)
+                bool on_hugetlbfs = false;
+#ifdef __linux__
+                struct statfs fs = {};
+                if (fstatfs(fd, &fs) == 0 && fs.f_type == HUGETLBFS_MAGIC)
+                {
+                    on_hugetlbfs = true;
+                    if (size % fs.f_bsize != 0)
+                    {
+                        close(fd);
+                        throw journal_error(fmt::format("size {} of page {} is not a multiple of huge page size {}", size, path, fs.f_bsize));
+                    }
+                }
+#endif // __linux__
+
+                if (master && on_hugetlbfs)
+                {
+                    // files on hugetlbfs do not support write, ftruncate is the only way to size them
+                    struct stat st = {};
+                    if (fstat(fd, &st) == -1 || (st.st_size < (off_t) size && ftruncate(fd, size) == -1))
+                    {
+                        close(fd);
+                        throw journal_error("failed to stretch for page " + path + " on hugetlbfs");
+                    }
+                } else if (master)
                 {
                     if (lseek(fd, size - 1, SEEK_SET) == -1)
                     {
@@ -101,7 +169,18 @@ namespace kungfu {
                  * or fd in the case of dup2) to refer to a new resource without the possibility of races where it might get reassigned to something
                  * else if you first released the old resource then attempted to regain it for the new resource.
                  */
-                void *buffer = mmap(0, size, master ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+                int prot = master ? (PROT_READ | PROT_WRITE) : PROT_READ;
+                void *buffer = MAP_FAILED;
+#ifdef __linux__
+                if (huge_page && !on_hugetlbfs && size >= HUGE_PAGE_SIZE)
+                {
+                    buffer = mmap_huge_page_aligned(fd, size, prot);
+                }
+#endif // __linux__
+                if (buffer == MAP_FAILED)
+                {
+                    buffer = mmap(0, size, prot, MAP_SHARED, fd, 0);
+                }
 
                 if (buffer == MAP_FAILED)
                 {
@@ -109,17 +188,28 @@ namespace kungfu {
                     throw journal_error("Error mapping file to buffer");
                 }
 
-                if (!lazy && madvise(buffer, size, MADV_RANDOM) != 0 && mlock(buffer, size) != 0)
+#ifdef __linux__
+                if (huge_page && !on_hugetlbfs && madvise(buffer, size, MADV_HUGEPAGE) != 0)
                 {
-                    munmap(buffer, size);
-                    close(fd);
-                    throw journal_error("failed to lock memory for page " + path);
+                    SPDLOG_DEBUG("transparent huge page not available for {}, use normal pages", path);
+                }
+#endif // __linux__
+
+                if (!lazy && madvise(buffer, size, MADV_RANDOM) != 0)
+                {
+                    SPDLOG_DEBUG("failed to advise random access for {}", path);
+                }
+
+                if (is_page_locking() && mlock(buffer, size) != 0)
+                {
+                    SPDLOG_WARN("failed to lock memory for page {}: {}", path, strerror(errno));
                 }
 
                 close(fd);
 #endif // _WINDOWS
 
-                SPDLOG_DEBUG("mapped {} - {} - {}", path, is_writing ? "rw" : "r", lazy ? "lazy" : "lock");
+                SPDLOG_DEBUG("mapped {} - {} - {}{}{}", path, is_writing ? "rw" : "r", lazy ? "lazy" : "random",
+                             is_page_locking() ? " - locked" : "", huge_page ? " - huge" : "");
                 return reinterpret_cast<uintptr_t>(buffer);
             }
 
@@ -130,20 +220,64 @@ namespace kungfu {
                 FlushViewOfFile(buffer, 0);
                 UnmapViewOfFile(buffer);
 #else
-                //unlock and unmap
-                if (!lazy && munlock(buffer, size) != 0)
+                // munmap releases locks held on the range as well
+                if (munmap(buffer, size) != 0)
                 {
                     return false;
                 }
+#endif // _WINDOWS
+                return true;
+            }
 
-                if (munmap(buffer, size) != 0)
+            static std::atomic<bool> page_locking(false);
+
+            void set_page_locking(bool locking)
+            {
+                page_locking = locking;
+            }
+
+            bool is_page_locking()
+            {
+                return page_locking;
+            }
+
+            bool advise_mmap_buffer(uintptr_t address, size_t size, mmap_advice advice)
+            {
+#ifdef _WINDOWS
+                return true;
+#else
+                int posix_advice = MADV_NORMAL;
+                switch (advice)
                 {
-                    return false;
+                    case mmap_advice::SEQUENTIAL:
+                        posix_advice = MADV_SEQUENTIAL;
+                        break;
+                    case mmap_advice::WILLNEED:
+                        posix_advice = MADV_WILLNEED;
+                        break;
+                    case mmap_advice::DONTNEED:
+                        posix_advice = MADV_DONTNEED;
+                        break;
                 }
+                return madvise(reinterpret_cast<void *>(address), size, posix_advice) == 0;
 #endif // _WINDOWS
-                return true;
             }
 
+            bool prefetch_file(const std::string &path)
+            {
+#ifdef __linux__
+                int fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    return false;
+                }
+                bool result = posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED) == 0;
+                close(fd);
+                return result;
+#else
+                return true;
+#endif // __linux__
+            }
         }
     }
 }
@@ -0,0 +1,152 @@
+/*****************************************************************************
+ * Copyright [taurus.ai]
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *****************************************************************************/
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif // __linux__
+
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <fmt/format.h>
+
+#include <kungfu/yijinjing/util/os.h>
+
+namespace kungfu
+{
+    namespace yijinjing
+    {
+        namespace os
+        {
+#ifdef __linux__
+            /** affinity of process before any runtime policy, helper threads get it back */
+            static std::mutex default_affinity_mutex;
+            static bool default_affinity_saved = false;
+            static cpu_set_t default_affinity;
+
+            static void save_default_affinity()
+            {
+                std::lock_guard<std::mutex> lock(default_affinity_mutex);
+                if (not default_affinity_saved)
+                {
+                    default_affinity_saved = pthread_getaffinity_np(pthread_self(), sizeof(default_affinity), &default_affinity) == 0;
+                }
+            }
+
+            static std::string apply_cpu_affinity(const std::vector<int> &cpus)
+            {
+                std::vector<std::string> report;
+                std::vector<int> pinned;
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (int cpu : cpus)
+                {
+                    if (cpu < 0 or cpu >= CPU_SETSIZE)
+                    {
+                        report.push_back(fmt::format("cpu {} out of range [0, {})", cpu, CPU_SETSIZE));
+                        continue;
+                    }
+                    CPU_SET(cpu, &set);
+                    pinned.push_back(cpu);
+                }
+                if (pinned.empty())
+                {
+                    report.emplace_back("cpu affinity left as is");
+                } else if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+                {
+                    report.push_back(fmt::format("cpu affinity {} failed", fmt::join(pinned, ",")));
+                } else
+                {
+                    report.push_back(fmt::format("pinned to cpu {}", fmt::join(pinned, ",")));
+                }
+                return fmt::format("{}", fmt::join(report, ", "));
+            }
+
+            static std::string apply_rt_priority(int priority)
+            {
+                int min = sched_get_priority_min(SCHED_FIFO);
+                int max = sched_get_priority_max(SCHED_FIFO);
+                if (priority < min or priority > max)
+                {
+                    return fmt::format("SCHED_FIFO {} out of range [{}, {}]", priority, min, max);
+                }
+                sched_param param = {};
+                param.sched_priority = priority;
+                int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+                if (result != 0)
+                {
+                    return fmt::format("SCHED_FIFO {} failed: {}", priority, strerror(result));
+                }
+                return fmt::format("SCHED_FIFO {}", priority);
+            }
+
+            static std::string apply_lock_memory()
+            {
+                set_page_locking(true);
+                if (mlockall(MCL_CURRENT) != 0)
+                {
+                    rlimit limit = {};
+                    getrlimit(RLIMIT_MEMLOCK, &limit);
+                    return fmt::format("lock memory failed: {}, RLIMIT_MEMLOCK {}", strerror(errno),
+                                       limit.rlim_cur == RLIM_INFINITY ? "unlimited" : std::to_string(limit.rlim_cur));
+                }
+                return "memory locked";
+            }
+#endif // __linux__
+
+            std::string apply_runtime_policy(const runtime_policy &policy)
+            {
+                std::vector<std::string> report(policy.errors);
+#ifdef __linux__
+                save_default_affinity();
+                if (not policy.cpu_affinity.empty())
+                {
+                    report.push_back(apply_cpu_affinity(policy.cpu_affinity));
+                }
+                if (policy.rt_priority > 0)
+                {
+                    report.push_back(apply_rt_priority(policy.rt_priority));
+                }
+                if (policy.lock_memory)
+                {
+                    report.push_back(apply_lock_memory());
+                }
+#else
+                if (not policy.cpu_affinity.empty() or policy.rt_priority > 0 or policy.lock_memory)
+                {
+                    report.emplace_back("runtime policy not supported on this platform");
+                }
+#endif // __linux__
+                return report.empty() ? "default runtime policy" : fmt::format("{}", fmt::join(report, ", "));
+            }
+
+            void reset_thread_policy()
+            {
+#ifdef __linux__
+                sched_param param = {};
+                pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+                std::lock_guard<std::mutex> lock(default_affinity_mutex);
+                if (default_affinity_saved)
+                {
+                    pthread_setaffinity_np(pthread_self(), sizeof(default_affinity), &default_affinity);
+                }
+#endif // __linux__
+            }
+        }
+    }
+}
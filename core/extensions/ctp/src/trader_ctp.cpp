@@ -462,22 +462,23 @@ namespace kungfu
                 if (bIsLast)
                 {
                     SPDLOG_TRACE("RequestID {}", nRequestID);
-                    auto writer = get_writer(0);
+                    yijinjing::journal::frame_batch batch(get_writer(0));
                     for (const auto& kv: long_position_map_)
                     {
                         const auto& position = kv.second;
                         SPDLOG_TRACE(kungfu::wingchun::msg::data::to_string(position));
-                        writer->write(0, msg::type::Position, position);
+                        batch.write(0, msg::type::Position, position);
                     }
                     for(const auto& kv: short_position_map_)
                     {
                         const auto& position = kv.second;
                         SPDLOG_TRACE(kungfu::wingchun::msg::data::to_string(position));
-                        writer->write(0, msg::type::Position, position);
+                        batch.write(0, msg::type::Position, position);
                     }
-                    msg::data::PositionEnd &end = writer->open_data<msg::data::PositionEnd>(0, msg::type::PositionEnd);
+                    msg::data::PositionEnd end = {};
                     end.holder_uid = get_io_device()->get_home()->uid;
-                    writer->close_data();
+                    batch.write(0, msg::type::PositionEnd, end);
+                    batch.commit();
                     short_position_map_.clear();
                     long_position_map_.clear();
                 }
@@ -35,17 +35,16 @@ namespace kungfu
 
             inline int64_t nsec_from_xtp_timestamp(int64_t xtp_time)
             {
-                std::tm result = {};
-                result.tm_year =  xtp_time / (int64_t)1e13 - 1900;
-                result.tm_mon = xtp_time % (int64_t)1e13 / (int64_t)1e11 -1;
-                result.tm_mday = xtp_time % (int64_t)1e11 / (int64_t)1e9;
-                result.tm_hour = xtp_time % (int64_t)1e9 / (int64_t)1e7;
-                result.tm_min =  xtp_time % (int)1e7 / (int)1e5;
-                result.tm_sec = xtp_time % (int)1e5 /(int)1e3;
-                int milli_sec = xtp_time %(int)1e3;
-                std::time_t parsed_time = std::mktime(&result);
-                int64_t nano = parsed_time * kungfu::yijinjing::time_unit::NANOSECONDS_PER_SECOND;
-                return parsed_time * kungfu::yijinjing::time_unit::NANOSECONDS_PER_SECOND + milli_sec * kungfu::yijinjing::time_unit::NANOSECONDS_PER_MILLISECOND;
+                // xtp time is yyyymmddHHMMSSsss
+                int year = xtp_time / (int64_t)1e13;
+                int month = xtp_time % (int64_t)1e13 / (int64_t)1e11;
+                int day = xtp_time % (int64_t)1e11 / (int64_t)1e9;
+                int hour = xtp_time % (int64_t)1e9 / (int64_t)1e7;
+                int minute = xtp_time % (int)1e7 / (int)1e5;
+                int second = xtp_time % (int)1e5 / (int)1e3;
+                int milli_sec = xtp_time % (int)1e3;
+                return kungfu::yijinjing::time::nano_from_date_time(year, month, day, hour, minute, second,
+                                                                    milli_sec * kungfu::yijinjing::time_unit::NANOSECONDS_PER_MILLISECOND);
             }
 
             inline void from_xtp(const XTP_MARKET_TYPE &xtp_market_type, char *exchange_id)
@@ -219,7 +218,7 @@ namespace kungfu
             {
                 strcpy(des.source_id, SOURCE_XTP);
                 des.data_time = nsec_from_xtp_timestamp(ori.data_time);
-                strcpy(des.trading_day, yijinjing::time::strftime(des.data_time, "%Y%m%d").c_str());
+                yijinjing::time::strfday(des.data_time, des.trading_day);
                 strcpy(des.instrument_id, ori.ticker);
                 from_xtp(ori.exchange_id, des.exchange_id);
 
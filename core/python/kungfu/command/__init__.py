@@ -61,9 +61,12 @@ class SpecialHelpOrder(click.Group):
 @click.option('-l', '--log_level', type=click.Choice(['trace', 'debug', 'info', 'warning', 'error', 'critical']),
               default='warning', help='logging level')
 @click.option('-n', '--name', type=str, help='name for the process, defaults to command if not set')
+@click.option('--cpu_affinity', type=str, help='comma separated cpus to pin the event loop thread to, e.g. 2,3')
+@click.option('--rt_priority', type=click.IntRange(0, 99), default=0, help='SCHED_FIFO priority of the event loop thread, 0 for normal scheduling')
+@click.option('--lock_memory', is_flag=True, help='lock process memory and prefault journal pages')
 @click.version_option(__version__, '--version', '-v', message = 'version {}'.format(__version__))
 @click.pass_context
-def kfc(ctx, home, log_level, name):
+def kfc(ctx, home, log_level, name, cpu_affinity, rt_priority, lock_memory):
     if not home:
         osname = platform.system()
         user_home = os.path.expanduser('~')
@@ -78,6 +81,12 @@ def kfc(ctx, home, log_level, name):
 
     os.environ['KF_HOME'] = ctx.home = home
     os.environ['KF_LOG_LEVEL'] = ctx.log_level = log_level
+    if cpu_affinity:
+        os.environ['KF_CPU_AFFINITY'] = cpu_affinity
+    if rt_priority:
+        os.environ['KF_RT_PRIORITY'] = str(rt_priority)
+    if lock_memory:
+        os.environ['KF_LOCK_MEMORY'] = '1'
 
     settings_path = os.path.join(home, 'settings.json')
     if not os.path.exists(settings_path):
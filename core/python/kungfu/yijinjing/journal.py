@@ -103,6 +103,15 @@ class Locator(pyyjj.locator):
                 page_ids.append(int(page_id))
         return page_ids
 
+    def page_size(self, location, dest_id):
+        # page size in MB can be set per source by env, e.g. KF_PAGE_SIZE_MD_XTP=512 or KF_PAGE_SIZE_TD_XTP_15011218=1
+        category = pyyjj.get_category_name(location.category)
+        for key in ['_'.join([category, location.group, location.name]), '_'.join([category, location.group])]:
+            size = os.getenv('KF_PAGE_SIZE_' + key.upper())
+            if size:
+                return int(size) * 1024 * 1024
+        return pyyjj.locator.page_size(self, location, dest_id)
+
 
 def collect_journal_locations(ctx):
 